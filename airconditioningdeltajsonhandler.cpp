@@ -0,0 +1,147 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-experience-plugin-airconditioning.
+*
+* nymea-experience-plugin-airconditioning is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-experience-plugin-airconditioning is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-experience-plugin-airconditioning. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "airconditioningdeltajsonhandler.h"
+#include "airconditioningmanager.h"
+
+#include <QMetaEnum>
+
+AirConditioningDeltaJsonHandler::AirConditioningDeltaJsonHandler(AirConditioningManager *manager, QObject *parent):
+    JsonHandler(parent),
+    m_manager(manager)
+{
+    QVariantMap params;
+    QString description;
+
+    params.clear();
+    description = "Emitted whenever a zone is added, changed or removed. changes only contains the properties "
+                  "that have changed, using the names and formats of the AirConditioning ZoneInfo object, except "
+                  "for setpointOverrideEnd which is given in seconds since epoch. For a newly added zone, changes "
+                  "contains all properties. For a removed zone, removed is true and changes is omitted. Enable "
+                  "notifications for this namespace instead of the AirConditioning namespace to stop receiving "
+                  "full zone objects for every sensor update.";
+    params.insert("zoneId", enumValueName(Uuid));
+    params.insert("revision", enumValueName(Uint));
+    params.insert("o:removed", enumValueName(Bool));
+    params.insert("o:changes", enumValueName(Object));
+    registerNotification("ZoneStateChanged", description, params);
+
+    connect(manager, &AirConditioningManager::zoneAdded, this, [=](const ZoneInfo &zone){
+        emit ZoneStateChanged({
+                                  {"zoneId", zone.id()},
+                                  {"revision", zone.revision()},
+                                  {"changes", packFields(zone, ZoneInfo::ZoneFieldAll)}
+                              });
+    });
+    connect(manager, &AirConditioningManager::zoneRemoved, this, [=](const QUuid &zoneId){
+        emit ZoneStateChanged({
+                                  {"zoneId", zoneId},
+                                  {"revision", m_manager->revision()},
+                                  {"removed", true}
+                              });
+    });
+    connect(manager, &AirConditioningManager::zoneChanged, this, [=](const ZoneInfo &zone, ZoneInfo::ZoneFields changedFields){
+        emit ZoneStateChanged({
+                                  {"zoneId", zone.id()},
+                                  {"revision", zone.revision()},
+                                  {"changes", packFields(zone, changedFields)}
+                              });
+    });
+}
+
+QString AirConditioningDeltaJsonHandler::name() const
+{
+    return "AirConditioningDelta";
+}
+
+QVariantMap AirConditioningDeltaJsonHandler::packFields(const ZoneInfo &zone, ZoneInfo::ZoneFields fields) const
+{
+    QVariantMap changes;
+    if (fields.testFlag(ZoneInfo::ZoneFieldName)) {
+        changes.insert("name", zone.name());
+    }
+    if (fields.testFlag(ZoneInfo::ZoneFieldCurrentSetpoint)) {
+        changes.insert("currentSetpoint", zone.currentSetpoint());
+    }
+    if (fields.testFlag(ZoneInfo::ZoneFieldStandbySetpoint)) {
+        changes.insert("standbySetpoint", zone.standbySetpoint());
+    }
+    if (fields.testFlag(ZoneInfo::ZoneFieldSetpointOverride)) {
+        changes.insert("setpointOverrideMode", enumValueName(zone.setpointOverrideMode()));
+        changes.insert("setpointOverride", zone.setpointOverride());
+        changes.insert("setpointOverrideEnd", zone.setpointOverrideEnd().isValid() ? zone.setpointOverrideEnd().toSecsSinceEpoch() : 0);
+    }
+    if (fields.testFlag(ZoneInfo::ZoneFieldThings)) {
+        QHash<QString, QList<ThingId>> thingLists = {
+            {"thermostats", zone.thermostats()},
+            {"valves", zone.valves()},
+            {"windowSensors", zone.windowSensors()},
+            {"indoorSensors", zone.indoorSensors()},
+            {"outdoorSensors", zone.outdoorSensors()},
+            {"notifications", zone.notifications()}
+        };
+        for (auto it = thingLists.constBegin(); it != thingLists.constEnd(); ++it) {
+            QVariantList thingIds;
+            foreach (const ThingId &thingId, it.value()) {
+                thingIds.append(thingId);
+            }
+            changes.insert(it.key(), thingIds);
+        }
+    }
+    if (fields.testFlag(ZoneInfo::ZoneFieldZoneStatus)) {
+        QStringList zoneStatus;
+        QMetaEnum flagEnum = QMetaEnum::fromType<ZoneInfo::ZoneStatusFlag>();
+        for (int i = 0; i < flagEnum.keyCount(); i++) {
+            ZoneInfo::ZoneStatusFlag flag = static_cast<ZoneInfo::ZoneStatusFlag>(flagEnum.value(i));
+            if (flag != ZoneInfo::ZoneStatusFlagNone && zone.zoneStatus().testFlag(flag)) {
+                zoneStatus.append(flagEnum.key(i));
+            }
+        }
+        changes.insert("zoneStatus", zoneStatus);
+    }
+    if (fields.testFlag(ZoneInfo::ZoneFieldTemperature)) {
+        changes.insert("temperature", zone.temperature());
+    }
+    if (fields.testFlag(ZoneInfo::ZoneFieldHumidity)) {
+        changes.insert("humidity", zone.humidity());
+    }
+    if (fields.testFlag(ZoneInfo::ZoneFieldVoc)) {
+        changes.insert("voc", zone.voc());
+    }
+    if (fields.testFlag(ZoneInfo::ZoneFieldPm25)) {
+        changes.insert("pm25", zone.pm25());
+    }
+    if (fields.testFlag(ZoneInfo::ZoneFieldWeekSchedule)) {
+        changes.insert("weekSchedule", pack(zone.weekSchedule()));
+    }
+    if (fields.testFlag(ZoneInfo::ZoneFieldAggregation)) {
+        changes.insert("temperatureAggregation", enumValueName(zone.temperatureAggregation()));
+        changes.insert("humidityAggregation", enumValueName(zone.humidityAggregation()));
+        changes.insert("vocAggregation", enumValueName(zone.vocAggregation()));
+        changes.insert("pm25Aggregation", enumValueName(zone.pm25Aggregation()));
+        changes.insert("smoothingFilter", enumValueName(zone.smoothingFilter()));
+        changes.insert("smoothingWindow", zone.smoothingWindow());
+    }
+    return changes;
+}
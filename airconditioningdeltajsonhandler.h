@@ -0,0 +1,56 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-experience-plugin-airconditioning.
+*
+* nymea-experience-plugin-airconditioning is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-experience-plugin-airconditioning is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-experience-plugin-airconditioning. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef AIRCONDITIONINGDELTAJSONHANDLER_H
+#define AIRCONDITIONINGDELTAJSONHANDLER_H
+
+#include <QObject>
+
+#include <jsonrpc/jsonhandler.h>
+
+#include "zoneinfo.h"
+
+class AirConditioningManager;
+
+// Emits compact zone updates carrying only the properties that changed. Clients opt in by
+// enabling notifications for this namespace instead of the AirConditioning namespace.
+class AirConditioningDeltaJsonHandler : public JsonHandler
+{
+    Q_OBJECT
+public:
+    explicit AirConditioningDeltaJsonHandler(AirConditioningManager *manager, QObject *parent = nullptr);
+
+    QString name() const override;
+
+signals:
+    void ZoneStateChanged(const QVariantMap &params);
+
+private:
+    QVariantMap packFields(const ZoneInfo &zone, ZoneInfo::ZoneFields fields) const;
+
+private:
+    AirConditioningManager *m_manager = nullptr;
+};
+
+#endif // AIRCONDITIONINGDELTAJSONHANDLER_H
@@ -25,9 +25,14 @@
 #include "airconditioningjsonhandler.h"
 #include "airconditioningmanager.h"
 
+#include <algorithm>
+
 
 Q_DECLARE_LOGGING_CATEGORY(dcAdaptiveLighting)
 
+// Upper limit for the number of transitions in GetZoneSchedulePreview
+static const int maxPreviewTransitions = 100;
+
 AirConditioningJsonHandler::AirConditioningJsonHandler(AirConditioningManager *manager, QObject *parent):
     JsonHandler(parent),
     m_manager(manager)
@@ -35,20 +40,135 @@ AirConditioningJsonHandler::AirConditioningJsonHandler(AirConditioningManager *m
     registerEnum<AirConditioningManager::AirConditioningError>();
     registerFlag<ZoneInfo::ZoneStatusFlag, ZoneInfo::ZoneStatus>();
     registerEnum<ZoneInfo::SetpointOverrideMode>();
+    registerEnum<ZoneInfo::AggregationMode>();
+    registerEnum<ZoneInfo::SmoothingFilter>();
     registerObject<ZoneInfo, ZoneInfos>();
     registerObject<TemperatureSchedule, TemperatureDaySchedule>();
     registerList<TemperatureWeekSchedule, TemperatureDaySchedule>();
+    registerObject<ScheduleConflict, ScheduleConflicts>();
+    registerEnum<ZoneHistory::Resolution>();
+    registerObject<ZoneHistoryEntry, ZoneHistoryEntries>();
 
     QVariantMap params, returns;
     QString description;
 
     params.clear(); returns.clear();
-    description = "Get all Zones.";
+    description = "Get all Zones. revision and epoch can be passed to GetZoneChanges later on to only fetch what has changed in the meantime. "
+                  "If zoneStatus is given, only zones having at least one of the given status flags are returned. "
+                  "Zones are ordered by name, offset and limit can be used to fetch them page by page, count holds the "
+                  "number of matching zones. If fields is given, zones is empty and zoneFields contains objects with only "
+                  "the id and the given ZoneInfo properties instead.";
     params.insert("o:zoneId", enumValueName(Uuid));
+    params.insert("o:zoneStatus", flagRef<ZoneInfo::ZoneStatus>());
+    params.insert("o:fields", enumValueName(StringList));
+    params.insert("o:offset", enumValueName(Uint));
+    params.insert("o:limit", enumValueName(Uint));
     returns.insert("airConditioningError", enumRef<AirConditioningManager::AirConditioningError>());
     returns.insert("zones", objectRef<ZoneInfos>());
+    returns.insert("o:zoneFields", QVariantList() << enumValueName(Object));
+    returns.insert("count", enumValueName(Uint));
+    returns.insert("revision", enumValueName(Uint));
+    returns.insert("epoch", enumValueName(Uuid));
     registerMethod("GetZones", description, params, returns, Types::PermissionScopeControlThings);
 
+    params.clear(); returns.clear();
+    description = "Get the zones which have been added or changed and the ids of zones which have been removed "
+                  "after the given revision. If the epoch differs from the given one (i.e. the server has been "
+                  "restarted) or the revision is too old, resyncRequired is true and the client needs to call "
+                  "GetZones instead.";
+    params.insert("sinceRevision", enumValueName(Uint));
+    params.insert("epoch", enumValueName(Uuid));
+    returns.insert("airConditioningError", enumRef<AirConditioningManager::AirConditioningError>());
+    returns.insert("resyncRequired", enumValueName(Bool));
+    returns.insert("revision", enumValueName(Uint));
+    returns.insert("epoch", enumValueName(Uuid));
+    returns.insert("o:zones", objectRef<ZoneInfos>());
+    returns.insert("o:removedZoneIds", QVariantList() << enumValueName(Uuid));
+    registerMethod("GetZoneChanges", description, params, returns, Types::PermissionScopeControlThings);
+
+    params.clear(); returns.clear();
+    description = "Get the recorded readings of a zone between from and to (in seconds since epoch, to defaults to now). "
+                  "History is kept in memory only: raw readings for the last hour, 1 minute averages for the last "
+                  "24 hours and 15 minute averages for the last 30 days. If resolution is not given, the finest one "
+                  "reaching back to from is used. Averages are weighted by how long each reading was held and timestamped "
+                  "with the start of their interval. They carry all status flags set during that interval. Raw entries are "
+                  "only recorded when the zone is evaluated, readings are unchanged in between.";
+    params.insert("zoneId", enumValueName(Uuid));
+    params.insert("from", enumValueName(Uint));
+    params.insert("o:to", enumValueName(Uint));
+    params.insert("o:resolution", enumRef<ZoneHistory::Resolution>());
+    returns.insert("airConditioningError", enumRef<AirConditioningManager::AirConditioningError>());
+    returns.insert("o:resolution", enumRef<ZoneHistory::Resolution>());
+    returns.insert("o:entries", objectRef<ZoneHistoryEntries>());
+    registerMethod("GetZoneHistory", description, params, returns, Types::PermissionScopeControlThings);
+
+    params.clear(); returns.clear();
+    description = "Get the readings and status transitions of a zone between from and to (in seconds since epoch, to "
+                  "defaults to now) from the telemetry database. Readings are stored at most once per minute for the "
+                  "last 7 days and as hourly averages for 2 years, transitions are kept for 2 years. Use GetZoneHistory "
+                  "for recent readings, this call needs to access the disk.";
+    params.insert("zoneId", enumValueName(Uuid));
+    params.insert("from", enumValueName(Uint));
+    params.insert("o:to", enumValueName(Uint));
+    returns.insert("airConditioningError", enumRef<AirConditioningManager::AirConditioningError>());
+    returns.insert("o:readings", objectRef<ZoneHistoryEntries>());
+    QVariantMap transition;
+    transition.insert("timestamp", enumValueName(Uint));
+    transition.insert("flag", enumRef<ZoneInfo::ZoneStatusFlag>());
+    transition.insert("active", enumValueName(Bool));
+    returns.insert("o:transitions", QVariantList() << transition);
+    registerMethod("GetZoneTelemetry", description, params, returns, Types::PermissionScopeControlThings);
+
+    params.clear(); returns.clear();
+    description = "Get the next transitions of the week schedule of a zone, starting now. Each transition gives the "
+                  "time (in seconds since epoch) and the setpoint from then on, which is the standby setpoint if no "
+                  "schedule is active. Setpoint overrides are not taken into account. count defaults to 10 and is "
+                  "limited to 100.";
+    params.insert("zoneId", enumValueName(Uuid));
+    params.insert("o:count", enumValueName(Uint));
+    returns.insert("airConditioningError", enumRef<AirConditioningManager::AirConditioningError>());
+    QVariantMap scheduleTransition;
+    scheduleTransition.insert("timestamp", enumValueName(Uint));
+    scheduleTransition.insert("scheduleActive", enumValueName(Bool));
+    scheduleTransition.insert("setpoint", enumValueName(Double));
+    returns.insert("o:transitions", QVariantList() << scheduleTransition);
+    registerMethod("GetZoneSchedulePreview", description, params, returns, Types::PermissionScopeControlThings);
+
+    params.clear(); returns.clear();
+    description = "Get the settings of the air conditioning engine. coalescingInterval is the time in ms in which "
+                  "changes to a zone are collected before the zone is evaluated, 0 evaluates once per event loop iteration. "
+                  "saveInterval is the time in ms after the first change to a zone at which changed zones are written to disk.";
+    returns.insert("coalescingInterval", enumValueName(Uint));
+    returns.insert("saveInterval", enumValueName(Uint));
+    registerMethod("GetSettings", description, params, returns, Types::PermissionScopeControlThings);
+
+    params.clear(); returns.clear();
+    description = "Change the settings of the air conditioning engine. See GetSettings for their meaning. "
+                  "Settings which are not given are left unchanged.";
+    params.insert("o:coalescingInterval", enumValueName(Uint));
+    params.insert("o:saveInterval", enumValueName(Uint));
+    returns.insert("airConditioningError", enumRef<AirConditioningManager::AirConditioningError>());
+    registerMethod("SetSettings", description, params, returns);
+
+    params.clear(); returns.clear();
+    description = "Get runtime statistics for tuning. coalescedEvaluations is the number of zone evaluations saved by "
+                  "coalescing since startup.";
+    returns.insert("coalescedEvaluations", enumValueName(Uint));
+    registerMethod("GetStatistics", description, params, returns, Types::PermissionScopeControlThings);
+
+    params.clear(); returns.clear();
+    description = "Get the latency of reacting to opened and closed windows since startup, per thermostat thing class "
+                  "and strategy (windowOpen, power or targetTemperature). Durations are in ms.";
+    QVariantMap actuationStats;
+    actuationStats.insert("thingClassId", enumValueName(Uuid));
+    actuationStats.insert("step", enumValueName(String));
+    actuationStats.insert("count", enumValueName(Uint));
+    actuationStats.insert("failures", enumValueName(Uint));
+    actuationStats.insert("averageDuration", enumValueName(Uint));
+    actuationStats.insert("maxDuration", enumValueName(Uint));
+    returns.insert("actuationStats", QVariantList() << actuationStats);
+    registerMethod("GetActuationStats", description, params, returns, Types::PermissionScopeControlThings);
+
     params.clear(); returns.clear();
     description = "Create a zones.";
     params.insert("name", enumValueName(String));
@@ -92,10 +212,11 @@ AirConditioningJsonHandler::AirConditioningJsonHandler(AirConditioningManager *m
     registerMethod("SetZoneSetpointOverride", description, params, returns, Types::PermissionScopeControlThings);
 
     params.clear(); returns.clear();
-    description = "Set the time schedule for a zone.";
+    description = "Set the time schedule for a zone. If the schedule is rejected with AirConditioningErrorInvalidTimeSpec, conflicts lists all entries that end before they start (otherIndex -1) and all pairs of overlapping entries.";
     params.insert("zoneId", enumValueName(Uuid));
     params.insert("weekSchedule", objectRef<TemperatureWeekSchedule>());
     returns.insert("airConditioningError", enumRef<AirConditioningManager::AirConditioningError>());
+    returns.insert("o:conflicts", objectRef<ScheduleConflicts>());
     registerMethod("SetZoneWeekSchedule", description, params, returns, Types::PermissionScopeControlThings);
 
     params.clear(); returns.clear();
@@ -110,6 +231,39 @@ AirConditioningJsonHandler::AirConditioningJsonHandler(AirConditioningManager *m
     returns.insert("airConditioningError", enumRef<AirConditioningManager::AirConditioningError>());
     registerMethod("SetZoneThings", description, params, returns);
 
+    params.clear(); returns.clear();
+    description = "Set how the readings of multiple sensors are combined into the zone temperature, humidity, VOC and PM2.5 values. "
+                  "Each sensor's readings can be smoothed over the last smoothingWindow (1 to 16) readings before. "
+                  "Omitted parameters keep their current value.";
+    params.insert("zoneId", enumValueName(Uuid));
+    params.insert("o:temperatureAggregation", enumRef<ZoneInfo::AggregationMode>());
+    params.insert("o:humidityAggregation", enumRef<ZoneInfo::AggregationMode>());
+    params.insert("o:vocAggregation", enumRef<ZoneInfo::AggregationMode>());
+    params.insert("o:pm25Aggregation", enumRef<ZoneInfo::AggregationMode>());
+    params.insert("o:smoothingFilter", enumRef<ZoneInfo::SmoothingFilter>());
+    params.insert("o:smoothingWindow", enumValueName(Uint));
+    returns.insert("airConditioningError", enumRef<AirConditioningManager::AirConditioningError>());
+    registerMethod("SetZoneAggregation", description, params, returns);
+
+    params.clear(); returns.clear();
+    description = "Change many zones at once. Each mutation changes the given properties of one zone, "
+                  "setpointOverride and mode must be given together. Either all mutations are applied or, "
+                  "if one of them is invalid, none of them. In that case failedIndex holds the index of the "
+                  "offending mutation. ZoneChanged is emitted only once for each affected zone.";
+    QVariantMap mutation;
+    mutation.insert("zoneId", enumValueName(Uuid));
+    mutation.insert("o:name", enumValueName(String));
+    mutation.insert("o:standbySetpoint", enumValueName(Double));
+    mutation.insert("o:setpointOverride", enumValueName(Double));
+    mutation.insert("o:mode", enumRef<ZoneInfo::SetpointOverrideMode>());
+    mutation.insert("o:minutes", enumValueName(Uint));
+    mutation.insert("o:weekSchedule", objectRef<TemperatureWeekSchedule>());
+    params.insert("mutations", QVariantList() << mutation);
+    returns.insert("airConditioningError", enumRef<AirConditioningManager::AirConditioningError>());
+    returns.insert("o:failedIndex", enumValueName(Int));
+    returns.insert("o:conflicts", objectRef<ScheduleConflicts>());
+    registerMethod("ApplyZoneMutations", description, params, returns, Types::PermissionScopeControlThings);
+
     params.clear();
     description = "Emitted whenever a zone is added";
     params.insert("zone", objectRef<ZoneInfo>());
@@ -126,13 +280,35 @@ AirConditioningJsonHandler::AirConditioningJsonHandler(AirConditioningManager *m
     registerNotification("ZoneChanged", description, params);
 
     connect(manager, &AirConditioningManager::zoneAdded, this, [=](const ZoneInfo &zone){
-        emit ZoneAdded({{"zone", pack(zone)}});
+        emit ZoneAdded({{"zone", packZone(zone)}});
     });
     connect(manager, &AirConditioningManager::zoneRemoved, this, [=](const QUuid &zoneId){
+        m_packedZones.remove(zoneId);
         emit ZoneRemoved({{"zoneId", zoneId}});
     });
     connect(manager, &AirConditioningManager::zoneChanged, this, [=](const ZoneInfo &zone){
-        emit ZoneChanged({{"zone", pack(zone)}});
+        emit ZoneChanged({{"zone", packZone(zone)}});
+    });
+    connect(manager->telemetry(), &ZoneTelemetry::fetchFinished, this, [=](int requestId, const ZoneHistoryEntries &readings, const QList<ZoneTransition> &transitions){
+        QPointer<JsonReply> reply = m_telemetryReplies.take(requestId);
+        if (!reply) {
+            // Timed out in the meantime
+            return;
+        }
+        QVariantList packedTransitions;
+        foreach (const ZoneTransition &transition, transitions) {
+            packedTransitions.append(QVariantMap({
+                                                     {"timestamp", transition.timestamp},
+                                                     {"flag", enumValueName(transition.flag)},
+                                                     {"active", transition.active}
+                                                 }));
+        }
+        reply->setData({
+                           {"airConditioningError", enumValueName(AirConditioningManager::AirConditioningErrorNoError)},
+                           {"readings", pack(readings)},
+                           {"transitions", packedTransitions}
+                       });
+        reply->finished();
     });
 }
 
@@ -150,10 +326,95 @@ JsonReply *AirConditioningJsonHandler::GetZones(const QVariantMap &params)
     } else {
         zones = m_manager->zones();
     }
-    return createReply({
-                           {"airConditioningError", enumValueName(AirConditioningManager::AirConditioningErrorNoError)},
-                           {"zones", pack(zones)}
-                       });
+
+    if (params.contains("zoneStatus")) {
+        QMetaEnum flagEnum = QMetaEnum::fromType<ZoneInfo::ZoneStatusFlag>();
+        ZoneInfo::ZoneStatus zoneStatus = ZoneInfo::ZoneStatusFlagNone;
+        foreach (const QString &flag, params.value("zoneStatus").toStringList()) {
+            zoneStatus |= static_cast<ZoneInfo::ZoneStatusFlag>(flagEnum.keyToValue(flag.toUtf8()));
+        }
+        ZoneInfos matchingZones;
+        foreach (const ZoneInfo &zone, zones) {
+            if (zone.zoneStatus() & zoneStatus) {
+                matchingZones.append(zone);
+            }
+        }
+        zones = matchingZones;
+    }
+
+    // Sort to keep pages stable across calls
+    std::sort(zones.begin(), zones.end(), [](const ZoneInfo &a, const ZoneInfo &b){
+        int result = QString::compare(a.name(), b.name(), Qt::CaseInsensitive);
+        return result == 0 ? a.id() < b.id() : result < 0;
+    });
+
+    int offset = qMin(params.value("offset", 0).toInt(), zones.count());
+    int limit = params.contains("limit") ? params.value("limit").toInt() : zones.count();
+    ZoneInfos page = zones.mid(offset, limit);
+
+    QVariantMap ret = {
+        {"airConditioningError", enumValueName(AirConditioningManager::AirConditioningErrorNoError)},
+        {"count", zones.count()},
+        {"revision", m_manager->revision()},
+        {"epoch", m_manager->epoch()}
+    };
+
+    QVariantList packedZones;
+    packedZones.reserve(page.count());
+    if (params.contains("fields")) {
+        QStringList fields = params.value("fields").toStringList();
+        foreach (const ZoneInfo &zone, page) {
+            QVariantMap packedZone = packZone(zone).toMap();
+            QVariantMap projectedZone = {{"id", packedZone.value("id")}};
+            foreach (const QString &field, fields) {
+                if (packedZone.contains(field)) {
+                    projectedZone.insert(field, packedZone.value(field));
+                }
+            }
+            packedZones.append(projectedZone);
+        }
+        ret.insert("zoneFields", packedZones);
+        ret.insert("zones", QVariantList());
+    } else {
+        foreach (const ZoneInfo &zone, page) {
+            packedZones.append(packZone(zone));
+        }
+        ret.insert("zones", packedZones);
+    }
+    return createReply(ret);
+}
+
+JsonReply *AirConditioningJsonHandler::GetZoneChanges(const QVariantMap &params)
+{
+    quint64 sinceRevision = params.value("sinceRevision").toULongLong();
+    QUuid epoch = params.value("epoch").toUuid();
+
+    QVariantMap ret = {
+        {"airConditioningError", enumValueName(AirConditioningManager::AirConditioningErrorNoError)},
+        {"revision", m_manager->revision()},
+        {"epoch", m_manager->epoch()}
+    };
+
+    ZoneInfos changedZones;
+    QList<QUuid> removedZones;
+    if (epoch != m_manager->epoch() || !m_manager->zoneChanges(sinceRevision, &changedZones, &removedZones)) {
+        ret.insert("resyncRequired", true);
+        return createReply(ret);
+    }
+
+    QVariantList packedZones;
+    packedZones.reserve(changedZones.count());
+    foreach (const ZoneInfo &zone, changedZones) {
+        packedZones.append(packZone(zone));
+    }
+    QVariantList removedZoneIds;
+    foreach (const QUuid &zoneId, removedZones) {
+        removedZoneIds.append(zoneId);
+    }
+    ret.insert("resyncRequired", false);
+    ret.insert("zones", packedZones);
+    ret.insert("removedZoneIds", removedZoneIds);
+    return createReply(ret);
 }
 
 JsonReply *AirConditioningJsonHandler::AddZone(const QVariantMap &params)
@@ -182,7 +443,7 @@ JsonReply *AirConditioningJsonHandler::AddZone(const QVariantMap &params)
         {"airConditioningError", enumValueName(status.first)}
     };
     if (status.first == AirConditioningManager::AirConditioningErrorNoError) {
-        ret.insert("zone", pack(status.second));
+        ret.insert("zone", packZone(status.second));
     }
     return createReply(ret);
 }
@@ -226,8 +487,13 @@ JsonReply *AirConditioningJsonHandler::SetZoneWeekSchedule(const QVariantMap &pa
 {
     TemperatureWeekSchedule weekSchedule = unpack<TemperatureWeekSchedule>(params.value("weekSchedule"));
     QUuid zoneId = params.value("zoneId").toUuid();
-    AirConditioningManager::AirConditioningError status = m_manager->setZoneWeekSchedules(zoneId, weekSchedule);
-    return createReply({{"airConditioningError", enumValueName(status)}});
+    ScheduleConflicts conflicts;
+    AirConditioningManager::AirConditioningError status = m_manager->setZoneWeekSchedules(zoneId, weekSchedule, &conflicts);
+    QVariantMap ret = {{"airConditioningError", enumValueName(status)}};
+    if (!conflicts.isEmpty()) {
+        ret.insert("conflicts", pack(conflicts));
+    }
+    return createReply(ret);
 }
 
 JsonReply *AirConditioningJsonHandler::SetZoneThings(const QVariantMap &params)
@@ -288,3 +554,211 @@ JsonReply *AirConditioningJsonHandler::SetZoneThings(const QVariantMap &params)
     AirConditioningManager::AirConditioningError status = m_manager->setZoneThings(zoneId, thermostats, valves, windowSensors, indoorSensors, outdoorSensors, notifications);
     return createReply({{"airConditioningError", enumValueName(status)}});
 }
+
+JsonReply *AirConditioningJsonHandler::SetZoneAggregation(const QVariantMap &params)
+{
+    QUuid zoneId = params.value("zoneId").toUuid();
+    ZoneInfo zone = m_manager->zone(zoneId);
+
+    QMetaEnum modeEnum = QMetaEnum::fromType<ZoneInfo::AggregationMode>();
+    ZoneInfo::AggregationMode temperatureAggregation = zone.temperatureAggregation();
+    if (params.contains("temperatureAggregation")) {
+        temperatureAggregation = static_cast<ZoneInfo::AggregationMode>(modeEnum.keyToValue(params.value("temperatureAggregation").toByteArray()));
+    }
+    ZoneInfo::AggregationMode humidityAggregation = zone.humidityAggregation();
+    if (params.contains("humidityAggregation")) {
+        humidityAggregation = static_cast<ZoneInfo::AggregationMode>(modeEnum.keyToValue(params.value("humidityAggregation").toByteArray()));
+    }
+    ZoneInfo::AggregationMode vocAggregation = zone.vocAggregation();
+    if (params.contains("vocAggregation")) {
+        vocAggregation = static_cast<ZoneInfo::AggregationMode>(modeEnum.keyToValue(params.value("vocAggregation").toByteArray()));
+    }
+    ZoneInfo::AggregationMode pm25Aggregation = zone.pm25Aggregation();
+    if (params.contains("pm25Aggregation")) {
+        pm25Aggregation = static_cast<ZoneInfo::AggregationMode>(modeEnum.keyToValue(params.value("pm25Aggregation").toByteArray()));
+    }
+    ZoneInfo::SmoothingFilter smoothingFilter = zone.smoothingFilter();
+    if (params.contains("smoothingFilter")) {
+        QMetaEnum filterEnum = QMetaEnum::fromType<ZoneInfo::SmoothingFilter>();
+        smoothingFilter = static_cast<ZoneInfo::SmoothingFilter>(filterEnum.keyToValue(params.value("smoothingFilter").toByteArray()));
+    }
+    uint smoothingWindow = params.value("smoothingWindow", zone.smoothingWindow()).toUInt();
+
+    AirConditioningManager::AirConditioningError status = m_manager->setZoneAggregation(zoneId, temperatureAggregation, humidityAggregation, vocAggregation, pm25Aggregation, smoothingFilter, smoothingWindow);
+    return createReply({{"airConditioningError", enumValueName(status)}});
+}
+
+JsonReply *AirConditioningJsonHandler::ApplyZoneMutations(const QVariantMap &params)
+{
+    QMetaEnum modeEnum = QMetaEnum::fromType<ZoneInfo::SetpointOverrideMode>();
+    QList<AirConditioningManager::ZoneMutation> mutations;
+    QVariantList mutationList = params.value("mutations").toList();
+    for (int i = 0; i < mutationList.count(); i++) {
+        QVariantMap mutationMap = mutationList.at(i).toMap();
+        AirConditioningManager::ZoneMutation mutation;
+        mutation.zoneId = mutationMap.value("zoneId").toUuid();
+        if (mutationMap.contains("name")) {
+            mutation.fields |= ZoneInfo::ZoneFieldName;
+            mutation.name = mutationMap.value("name").toString();
+        }
+        if (mutationMap.contains("standbySetpoint")) {
+            mutation.fields |= ZoneInfo::ZoneFieldStandbySetpoint;
+            mutation.standbySetpoint = mutationMap.value("standbySetpoint").toDouble();
+        }
+        if (mutationMap.contains("setpointOverride") != mutationMap.contains("mode")) {
+            return createReply({
+                                   {"airConditioningError", enumValueName(AirConditioningManager::AirConditioningErrorInvalidParameter)},
+                                   {"failedIndex", i}
+                               });
+        }
+        if (mutationMap.contains("setpointOverride")) {
+            mutation.fields |= ZoneInfo::ZoneFieldSetpointOverride;
+            mutation.setpointOverride = mutationMap.value("setpointOverride").toDouble();
+            mutation.setpointOverrideMode = static_cast<ZoneInfo::SetpointOverrideMode>(modeEnum.keyToValue(mutationMap.value("mode").toByteArray()));
+            mutation.setpointOverrideMinutes = mutationMap.value("minutes", 0).toUInt();
+        }
+        if (mutationMap.contains("weekSchedule")) {
+            mutation.fields |= ZoneInfo::ZoneFieldWeekSchedule;
+            mutation.weekSchedule = unpack<TemperatureWeekSchedule>(mutationMap.value("weekSchedule"));
+        }
+        mutations.append(mutation);
+    }
+
+    int failedIndex = -1;
+    ScheduleConflicts conflicts;
+    AirConditioningManager::AirConditioningError status = m_manager->applyZoneMutations(mutations, &failedIndex, &conflicts);
+    QVariantMap ret = {{"airConditioningError", enumValueName(status)}};
+    if (status != AirConditioningManager::AirConditioningErrorNoError) {
+        ret.insert("failedIndex", failedIndex);
+    }
+    if (!conflicts.isEmpty()) {
+        ret.insert("conflicts", pack(conflicts));
+    }
+    return createReply(ret);
+}
+
+QVariant AirConditioningJsonHandler::packZone(const ZoneInfo &zone)
+{
+    // Unknown zones (e.g. GetZones with an invalid id) have no revision and are not cached
+    if (zone.id().isNull()) {
+        return pack(zone);
+    }
+
+    PackedZone &entry = m_packedZones[zone.id()];
+    if (!entry.packed.isValid() || entry.revision != zone.revision()) {
+        entry.revision = zone.revision();
+        entry.packed = pack(zone);
+    }
+    return entry.packed;
+}
+
+JsonReply *AirConditioningJsonHandler::GetZoneHistory(const QVariantMap &params)
+{
+    QUuid zoneId = params.value("zoneId").toUuid();
+    QDateTime now = m_manager->clock()->now();
+    QDateTime from = QDateTime::fromSecsSinceEpoch(params.value("from").toLongLong());
+    QDateTime to = params.contains("to") ? QDateTime::fromSecsSinceEpoch(params.value("to").toLongLong()) : now;
+
+    ZoneHistory::Resolution resolution = ZoneHistory::resolutionFor(from, now);
+    if (params.contains("resolution")) {
+        QMetaEnum resolutionEnum = QMetaEnum::fromType<ZoneHistory::Resolution>();
+        resolution = static_cast<ZoneHistory::Resolution>(resolutionEnum.keyToValue(params.value("resolution").toByteArray()));
+    }
+
+    ZoneHistoryEntries entries;
+    AirConditioningManager::AirConditioningError status = m_manager->zoneHistory(zoneId, from, to, resolution, &entries);
+    if (status != AirConditioningManager::AirConditioningErrorNoError) {
+        return createReply({{"airConditioningError", enumValueName(status)}});
+    }
+    return createReply({
+                           {"airConditioningError", enumValueName(status)},
+                           {"resolution", enumValueName(resolution)},
+                           {"entries", pack(entries)}
+                       });
+}
+
+JsonReply *AirConditioningJsonHandler::GetZoneTelemetry(const QVariantMap &params)
+{
+    QUuid zoneId = params.value("zoneId").toUuid();
+    QDateTime from = QDateTime::fromSecsSinceEpoch(params.value("from").toLongLong());
+    QDateTime to = params.contains("to") ? QDateTime::fromSecsSinceEpoch(params.value("to").toLongLong()) : m_manager->clock()->now();
+
+    if (m_manager->zone(zoneId).id().isNull()) {
+        return createReply({{"airConditioningError", enumValueName(AirConditioningManager::AirConditioningErrorZoneNotFound)}});
+    }
+    if (from > to) {
+        return createReply({{"airConditioningError", enumValueName(AirConditioningManager::AirConditioningErrorInvalidTimeSpec)}});
+    }
+
+    JsonReply *reply = createAsyncReply("GetZoneTelemetry");
+    int requestId = m_manager->telemetry()->fetch(zoneId, from, to);
+    m_telemetryReplies.insert(requestId, reply);
+    return reply;
+}
+
+JsonReply *AirConditioningJsonHandler::GetZoneSchedulePreview(const QVariantMap &params)
+{
+    ZoneInfo zone = m_manager->zone(params.value("zoneId").toUuid());
+    if (zone.id().isNull()) {
+        return createReply({{"airConditioningError", enumValueName(AirConditioningManager::AirConditioningErrorZoneNotFound)}});
+    }
+    int count = qBound(0, params.value("count", 10).toInt(), maxPreviewTransitions);
+
+    QVariantList transitions;
+    foreach (const CompiledWeekSchedule::Transition &transition, zone.compiledWeekSchedule().upcomingTransitions(m_manager->clock()->now(), count)) {
+        transitions.append(QVariantMap({
+                                           {"timestamp", transition.time.toSecsSinceEpoch()},
+                                           {"scheduleActive", transition.scheduleActive},
+                                           {"setpoint", transition.scheduleActive ? transition.temperature : zone.standbySetpoint()}
+                                       }));
+    }
+    return createReply({
+                           {"airConditioningError", enumValueName(AirConditioningManager::AirConditioningErrorNoError)},
+                           {"transitions", transitions}
+                       });
+}
+
+JsonReply *AirConditioningJsonHandler::GetSettings(const QVariantMap &params)
+{
+    Q_UNUSED(params)
+    return createReply({
+                           {"coalescingInterval", m_manager->coalescingInterval()},
+                           {"saveInterval", m_manager->saveInterval()}
+                       });
+}
+
+JsonReply *AirConditioningJsonHandler::SetSettings(const QVariantMap &params)
+{
+    if (params.contains("coalescingInterval")) {
+        m_manager->setCoalescingInterval(params.value("coalescingInterval").toInt());
+    }
+    if (params.contains("saveInterval")) {
+        m_manager->setSaveInterval(params.value("saveInterval").toInt());
+    }
+    return createReply({{"airConditioningError", enumValueName(AirConditioningManager::AirConditioningErrorNoError)}});
+}
+
+JsonReply *AirConditioningJsonHandler::GetStatistics(const QVariantMap &params)
+{
+    Q_UNUSED(params)
+    return createReply({
+                           {"coalescedEvaluations", m_manager->coalescedEvaluations()}
+                       });
+}
+
+JsonReply *AirConditioningJsonHandler::GetActuationStats(const QVariantMap &params)
+{
+    Q_UNUSED(params)
+    QVariantList actuationStats;
+    foreach (const AirConditioningManager::ActuationStats &stats, m_manager->actuationStats()) {
+        actuationStats.append(QVariantMap({
+                                              {"thingClassId", stats.thingClassId},
+                                              {"step", stats.step},
+                                              {"count", stats.count},
+                                              {"failures", stats.failures},
+                                              {"averageDuration", stats.count > 0 ? stats.totalDuration / stats.count : 0},
+                                              {"maxDuration", stats.maxDuration}
+                                          }));
+    }
+    return createReply({{"actuationStats", actuationStats}});
+}
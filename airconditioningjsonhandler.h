@@ -27,8 +27,13 @@
 
 #include <QObject>
 
+#include <QHash>
+#include <QPointer>
+
 #include <jsonrpc/jsonhandler.h>
 
+#include "zoneinfo.h"
+
 class AirConditioningManager;
 
 class AirConditioningJsonHandler : public JsonHandler
@@ -40,6 +45,7 @@ public:
     QString name() const override;
 
     Q_INVOKABLE JsonReply *GetZones(const QVariantMap &params);
+    Q_INVOKABLE JsonReply *GetZoneChanges(const QVariantMap &params);
     Q_INVOKABLE JsonReply *AddZone(const QVariantMap &params);
     Q_INVOKABLE JsonReply *RemoveZone(const QVariantMap &params);
     Q_INVOKABLE JsonReply *SetZoneName(const QVariantMap &params);
@@ -47,14 +53,36 @@ public:
     Q_INVOKABLE JsonReply *SetZoneSetpointOverride(const QVariantMap &params);
     Q_INVOKABLE JsonReply* SetZoneWeekSchedule(const QVariantMap &params);
     Q_INVOKABLE JsonReply *SetZoneThings(const QVariantMap &params);
+    Q_INVOKABLE JsonReply *SetZoneAggregation(const QVariantMap &params);
+    Q_INVOKABLE JsonReply *ApplyZoneMutations(const QVariantMap &params);
+    Q_INVOKABLE JsonReply *GetZoneHistory(const QVariantMap &params);
+    Q_INVOKABLE JsonReply *GetZoneTelemetry(const QVariantMap &params);
+    Q_INVOKABLE JsonReply *GetZoneSchedulePreview(const QVariantMap &params);
+    Q_INVOKABLE JsonReply *GetSettings(const QVariantMap &params);
+    Q_INVOKABLE JsonReply *SetSettings(const QVariantMap &params);
+    Q_INVOKABLE JsonReply *GetStatistics(const QVariantMap &params);
+    Q_INVOKABLE JsonReply *GetActuationStats(const QVariantMap &params);
 
 signals:
     void ZoneAdded(const QVariantMap &params);
     void ZoneRemoved(const QVariantMap &params);
     void ZoneChanged(const QVariantMap &params);
 
+private:
+    QVariant packZone(const ZoneInfo &zone);
+
 private:
     AirConditioningManager *m_manager = nullptr;
+
+    // Packed zones, reused as long as the zone's revision doesn't change
+    struct PackedZone {
+        quint64 revision = 0;
+        QVariant packed;
+    };
+    QHash<QUuid, PackedZone> m_packedZones;
+
+    // GetZoneTelemetry replies waiting for the database, by fetch request id
+    QHash<int, QPointer<JsonReply>> m_telemetryReplies;
 };
 
 #endif // AIRCONDITIONINGJSONHANDLER_H
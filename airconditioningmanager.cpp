@@ -24,43 +24,133 @@
 
 #include "airconditioningmanager.h"
 #include "zoneinfo.h"
+#include "zonestatusthresholds.h"
 
 #include <nymeasettings.h>
 
 #include <QMetaEnum>
+#include <QSettings>
 #include <qmath.h>
 
 Q_DECLARE_LOGGING_CATEGORY(dcAirConditioning)
 
+// Even if nothing is due, wake up every now and then in case the system clock jumped
+static const int maxUpdateInterval = 15 * 60 * 1000;
+
+static QString settingsFileName(const QString &settingsPath)
+{
+    return settingsPath + "/airconditioning-settings.conf";
+}
+
+// Status flags only switch once they have been in their current state for this long (in seconds)
+static const int statusFlagDwellTime = 5 * 60;
+
+static QList<ThingId> withoutThing(QList<ThingId> thingIds, const ThingId &thingId)
+{
+    thingIds.removeAll(thingId);
+    return thingIds;
+}
+
 AirConditioningManager::AirConditioningManager(ThingManager *thingManager, QObject *parent):
+    AirConditioningManager(new NymeaThingRegistry(thingManager), new Clock(), NymeaSettings::settingsPath(), parent)
+{
+
+}
+
+AirConditioningManager::AirConditioningManager(ThingRegistry *things, Clock *clock, const QString &settingsPath, QObject *parent):
     QObject(parent),
-    m_thingManager(thingManager)
+    m_things(things),
+    m_settingsPath(settingsPath),
+    m_storage(settingsPath),
+    m_clock(clock)
 {
-    qCDebug(dcAirConditioning()) << "Loading air conditioning experience...";
-    connect(m_thingManager, &ThingManager::thingAdded, this, &AirConditioningManager::onThingAdded);
-    connect(m_thingManager, &ThingManager::thingRemoved, this, &AirConditioningManager::onThingRemoved);
-    connect(m_thingManager, &ThingManager::thingStateChanged, this, &AirConditioningManager::onThingStateChaged);
-    connect(m_thingManager, &ThingManager::actionExecuted, this, &AirConditioningManager::onActionExecuted);
+    m_things->setParent(this);
+    m_clock->setParent(this);
+    connect(m_clock, &Clock::wakeup, this, &AirConditioningManager::onWakeup);
 
-    foreach (Thing *thing, m_thingManager->configuredThings()) {
-        if (thing->thingClass().interfaces().contains("thermostat")) {
-            m_thermostats.insert(thing->id(), new Thermostat(m_thingManager, thing, this));
+    qCDebug(dcAirConditioning()) << "Loading air conditioning experience...";
+    connect(m_things, &ThingRegistry::thingAdded, this, &AirConditioningManager::onThingAdded);
+    connect(m_things, &ThingRegistry::thingRemoved, this, &AirConditioningManager::onThingRemoved);
+    connect(m_things, &ThingRegistry::thingChanged, this, &AirConditioningManager::onThingChanged);
+    connect(m_things, &ThingRegistry::thingStateChanged, this, &AirConditioningManager::onThingStateChaged);
+    connect(m_things, &ThingRegistry::actionExecuted, this, &AirConditioningManager::onActionExecuted);
+
+    foreach (Thing *thing, m_things->configuredThings()) {
+        Capabilities capabilities = thingClassInfo(thing).capabilities;
+        if (capabilities.testFlag(CapabilityThermostat)) {
+            addThermostat(thing);
         }
-        if (thing->thingClass().interfaces().contains("notifications")) {
-            m_notifications.insert(thing->id(), new Notifications(m_thingManager, thing, this));
+        if (capabilities.testFlag(CapabilityNotifications)) {
+            Notifications *notifications = new Notifications(m_things, thing, m_clock, this);
+            connect(notifications, &Notifications::nextRearmChanged, this, &AirConditioningManager::requestWakeup);
+            m_notifications.insert(thing->id(), notifications);
         }
     }
 
+    m_telemetry = new ZoneTelemetry(m_settingsPath, this);
+
+    m_epoch = QUuid::createUuid();
     loadZones();
+    m_changeLogStart = m_revision;
+
+    m_saveTimer = new QTimer(this);
+    m_saveTimer->setSingleShot(true);
+    connect(m_saveTimer, &QTimer::timeout, this, &AirConditioningManager::saveZones);
+
+    m_coalescingTimer = new QTimer(this);
+    m_coalescingTimer->setSingleShot(true);
+    m_coalescingTimer->setInterval(0);
+    connect(m_coalescingTimer, &QTimer::timeout, this, &AirConditioningManager::flushDirtyZones);
+
+    QSettings settings(settingsFileName(m_settingsPath), QSettings::IniFormat);
+    m_coalescingTimer->setInterval(qMax(0, settings.value("coalescingInterval", 0).toInt()));
+    m_saveTimer->setInterval(qMax(0, settings.value("saveInterval", 5000).toInt()));
+
+    // Evaluate everything once at startup, this will also request the first wakeup
+    update();
+}
 
-    m_updateTimer = new QTimer(this);
-    m_updateTimer->start(1000);
-    connect(m_updateTimer, &QTimer::timeout, this, [=](){
-        if (m_lastUpdateTime.time().minute() != QDateTime::currentDateTime().time().minute()) {
-            m_lastUpdateTime = QDateTime::currentDateTime();
-            update();
+AirConditioningManager::~AirConditioningManager()
+{
+    // Make sure pending changes hit the disk
+    saveZones();
+}
+
+Clock *AirConditioningManager::clock() const
+{
+    return m_clock;
+}
+
+ZoneTelemetry *AirConditioningManager::telemetry() const
+{
+    return m_telemetry;
+}
+
+quint64 AirConditioningManager::revision() const
+{
+    return m_revision;
+}
+
+QUuid AirConditioningManager::epoch() const
+{
+    return m_epoch;
+}
+
+bool AirConditioningManager::zoneChanges(quint64 sinceRevision, ZoneInfos *changedZones, QList<QUuid> *removedZones) const
+{
+    if (sinceRevision < m_changeLogStart || sinceRevision > m_revision) {
+        return false;
+    }
+
+    foreach (const ZoneInfo &zone, m_zones) {
+        if (zone.revision() > sinceRevision) {
+            changedZones->append(zone);
         }
-    });
+    }
+    for (auto it = m_removedZones.upperBound(sinceRevision); it != m_removedZones.constEnd(); ++it) {
+        removedZones->append(it.value());
+    }
+    return true;
 }
 
 ZoneInfos AirConditioningManager::zones() const
@@ -90,9 +180,11 @@ QPair<AirConditioningManager::AirConditioningError, ZoneInfo> AirConditioningMan
     zone.setIndoorSensors(indoorSensors);
     zone.setOutdoorSensors(outdoorSensors);
     zone.setNotifications(notifications);
+    zone.setRevision(++m_revision);
 
     m_zones.insert(zone.id(), zone);
-    saveZones();
+    indexZone(zone);
+    scheduleZoneSave(zone.id());
 
     emit zoneAdded(zone);
     return QPair<AirConditioningError, ZoneInfo>(AirConditioningErrorNoError, zone);
@@ -103,8 +195,18 @@ AirConditioningManager::AirConditioningError AirConditioningManager::removeZone(
     if (!m_zones.contains(zoneId)) {
         return AirConditioningErrorZoneNotFound;
     }
-    m_zones.remove(zoneId);
-    saveZones();
+    unindexZone(m_zones.take(zoneId));
+    m_removedZones.insert(++m_revision, zoneId);
+    while (m_removedZones.count() > maxRemovedZones) {
+        m_changeLogStart = m_removedZones.firstKey();
+        m_removedZones.remove(m_changeLogStart);
+    }
+    setZoneDeadline(zoneId, QDateTime());
+    m_statusFlagChanges.remove(zoneId);
+    m_zoneHistories.remove(zoneId);
+    m_telemetry->removeZone(zoneId);
+    requestWakeup();
+    scheduleZoneSave(zoneId);
 
     emit zoneRemoved(zoneId);
     return AirConditioningErrorNoError;
@@ -116,9 +218,9 @@ AirConditioningManager::AirConditioningError AirConditioningManager::setZoneName
         return AirConditioningErrorZoneNotFound;
     }
     m_zones[zoneId].setName(name);
-    saveZones();
+    scheduleZoneSave(zoneId);
 
-    emit zoneChanged(m_zones.value(zoneId));
+    notifyZoneChanged(zoneId, ZoneInfo::ZoneFieldName);
     return AirConditioningErrorNoError;
 }
 
@@ -129,52 +231,31 @@ AirConditioningManager::AirConditioningError AirConditioningManager::setZoneStan
     }
     m_zones[zoneId].setStandbySetpoint(standbySetpoint);
 
-    saveZones();
+    scheduleZoneSave(zoneId);
 
-    emit zoneChanged(m_zones.value(zoneId));
+    notifyZoneChanged(zoneId, ZoneInfo::ZoneFieldStandbySetpoint);
 
-    update();
+    scheduleZoneUpdate(zoneId);
 
     return AirConditioningErrorNoError;
 }
 
-AirConditioningManager::AirConditioningError AirConditioningManager::setZoneWeekSchedules(const QUuid &zoneId, const TemperatureWeekSchedule &weekSchedule)
+AirConditioningManager::AirConditioningError AirConditioningManager::setZoneWeekSchedules(const QUuid &zoneId, const TemperatureWeekSchedule &weekSchedule, ScheduleConflicts *conflicts)
 {
     if (!m_zones.contains(zoneId)) {
         return AirConditioningErrorZoneNotFound;
     }
 
-    if (weekSchedule.count() != 7) {
-        qCWarning(dcAirConditioning()) << "There must be exactly 7 schedules in a week schedule:" << weekSchedule;
-        return AirConditioningErrorInvalidTimeSpec;
-    }
-    for (int day = 0; day < 7; day++) {
-        TemperatureDaySchedule daySchedule = weekSchedule.at(day);
-        for (int i = 0; i < daySchedule.count(); i++) {
-            TemperatureSchedule schedule = daySchedule.at(i);
-            if (schedule.startTime() >= schedule.endTime()) {
-                qCWarning(dcAirConditioning()) << "Invalid time spec. startTime mus be earlier than endTime:" << schedule;
-                return AirConditioningErrorInvalidTimeSpec;
-            }
-            for (int j = i+1; j < daySchedule.count(); j++) {
-                TemperatureSchedule other = daySchedule.at(j);
-                if (other.startTime() < schedule.startTime() && other.endTime() > schedule.startTime()) {
-                    qCWarning(dcAirConditioning()) << "Invalid time spec. Overlapping schedules:\n" << schedule << "\n" << other;
-                    return AirConditioningErrorInvalidTimeSpec;
-                }
-                if (other.startTime() < schedule.endTime() && other.endTime() > schedule.startTime()) {
-                    qCWarning(dcAirConditioning()) << "Invalid time spec. Overlapping schedules:\n" << schedule << "\n" << other;
-                    return AirConditioningErrorInvalidTimeSpec;
-                }
-            }
-        }
+    AirConditioningError status = validateWeekSchedule(weekSchedule, conflicts);
+    if (status != AirConditioningErrorNoError) {
+        return status;
     }
 
     m_zones[zoneId].setWeekSchedule(weekSchedule);
-    saveZones();
-    emit zoneChanged(m_zones.value(zoneId));
+    scheduleZoneSave(zoneId);
+    notifyZoneChanged(zoneId, ZoneInfo::ZoneFieldWeekSchedule);
     qCInfo(dcAirConditioning()) << "Temperature schedule saved:" << weekSchedule;
-    update();
+    scheduleZoneUpdate(zoneId);
     return AirConditioningErrorNoError;
 }
 
@@ -187,16 +268,42 @@ AirConditioningManager::AirConditioningError AirConditioningManager::setZoneThin
     if (status != AirConditioningErrorNoError) {
         return status;
     }
+    unindexZone(m_zones.value(zoneId));
     m_zones[zoneId].setThermostats(thermostats);
     m_zones[zoneId].setValves(valves);
     m_zones[zoneId].setWindowSensors(windowSensors);
     m_zones[zoneId].setIndoorSensors(indoorSensors);
     m_zones[zoneId].setOutdoorSensors(outdoorSensors);
     m_zones[zoneId].setNotifications(notifications);
-    saveZones();
+    indexZone(m_zones.value(zoneId));
+    scheduleZoneSave(zoneId);
     qCDebug(dcAirConditioning()) << "Zone things set. Thermostats:" << thermostats << "valves:" << valves << "Window sensors:" << windowSensors << "indoor sensors:" << indoorSensors << "outdoor sensors:" << outdoorSensors << "notifications:" << notifications;
-    emit zoneChanged(m_zones.value(zoneId));
-    updateZone(zoneId);
+    notifyZoneChanged(zoneId, ZoneInfo::ZoneFieldThings);
+    scheduleZoneUpdate(zoneId);
+    return AirConditioningErrorNoError;
+}
+
+AirConditioningManager::AirConditioningError AirConditioningManager::setZoneAggregation(const QUuid &zoneId, ZoneInfo::AggregationMode temperatureAggregation, ZoneInfo::AggregationMode humidityAggregation, ZoneInfo::AggregationMode vocAggregation, ZoneInfo::AggregationMode pm25Aggregation, ZoneInfo::SmoothingFilter smoothingFilter, uint smoothingWindow)
+{
+    if (!m_zones.contains(zoneId)) {
+        return AirConditioningErrorZoneNotFound;
+    }
+    if (smoothingWindow < 1 || smoothingWindow > static_cast<uint>(SensorAggregate::maxWindow)) {
+        qCWarning(dcAirConditioning()) << "Smoothing window must be between 1 and" << SensorAggregate::maxWindow << "samples:" << smoothingWindow;
+        return AirConditioningErrorInvalidParameter;
+    }
+    ZoneInfo &zone = m_zones[zoneId];
+    zone.setTemperatureAggregation(temperatureAggregation);
+    zone.setHumidityAggregation(humidityAggregation);
+    zone.setVocAggregation(vocAggregation);
+    zone.setPm25Aggregation(pm25Aggregation);
+    zone.setSmoothingFilter(smoothingFilter);
+    zone.setSmoothingWindow(smoothingWindow);
+    // Start over with the new filter
+    bindZone(zone);
+    scheduleZoneSave(zoneId);
+    notifyZoneChanged(zoneId, ZoneInfo::ZoneFieldAggregation);
+    scheduleZoneUpdate(zoneId);
     return AirConditioningErrorNoError;
 }
 
@@ -205,65 +312,204 @@ AirConditioningManager::AirConditioningError AirConditioningManager::setZoneSetp
     if (!m_zones.contains(zoneId)) {
         return AirConditioningErrorZoneNotFound;
     }
-    m_zones[zoneId].setSetpointOverride(setpoint, mode, QDateTime::currentDateTime().addMSecs(minutes * 60000));
-    m_eventualOverrideCache[zoneId] = (m_zones[zoneId].zoneStatus() | ZoneInfo::ZoneStatusFlagSetpointOverrideActive);
-    qCDebug(dcAirConditioning()) << "Memorizing zone status:" << m_eventualOverrideCache.value(zoneId);
-    saveZones();
-    emit zoneChanged(m_zones.value(zoneId));
-    updateZone(zoneId);
+    applySetpointOverride(zoneId, setpoint, mode, minutes);
+    scheduleZoneSave(zoneId);
+    notifyZoneChanged(zoneId, ZoneInfo::ZoneFieldSetpointOverride);
+    scheduleZoneUpdate(zoneId);
     return AirConditioningErrorNoError;
 }
 
+AirConditioningManager::AirConditioningError AirConditioningManager::applyZoneMutations(const QList<ZoneMutation> &mutations, int *failedIndex, ScheduleConflicts *conflicts)
+{
+    // Validate everything first so that a failing mutation leaves all zones untouched
+    for (int i = 0; i < mutations.count(); i++) {
+        const ZoneMutation &mutation = mutations.at(i);
+        AirConditioningError status = AirConditioningErrorNoError;
+        if (!m_zones.contains(mutation.zoneId)) {
+            status = AirConditioningErrorZoneNotFound;
+        } else if (mutation.fields.testFlag(ZoneInfo::ZoneFieldWeekSchedule)) {
+            status = validateWeekSchedule(mutation.weekSchedule, conflicts);
+        }
+        if (status != AirConditioningErrorNoError) {
+            qCWarning(dcAirConditioning()) << "Rejecting zone mutations. Mutation" << i << "for zone" << mutation.zoneId << "failed:" << status;
+            if (failedIndex) {
+                *failedIndex = i;
+            }
+            return status;
+        }
+    }
+
+    QHash<QUuid, ZoneInfo::ZoneFields> changedZones;
+    foreach (const ZoneMutation &mutation, mutations) {
+        ZoneInfo &zone = m_zones[mutation.zoneId];
+        if (mutation.fields.testFlag(ZoneInfo::ZoneFieldName)) {
+            zone.setName(mutation.name);
+        }
+        if (mutation.fields.testFlag(ZoneInfo::ZoneFieldStandbySetpoint)) {
+            zone.setStandbySetpoint(mutation.standbySetpoint);
+        }
+        if (mutation.fields.testFlag(ZoneInfo::ZoneFieldWeekSchedule)) {
+            zone.setWeekSchedule(mutation.weekSchedule);
+        }
+        if (mutation.fields.testFlag(ZoneInfo::ZoneFieldSetpointOverride)) {
+            applySetpointOverride(mutation.zoneId, mutation.setpointOverride, mutation.setpointOverrideMode, mutation.setpointOverrideMinutes);
+        }
+        changedZones[mutation.zoneId] |= mutation.fields;
+    }
+
+    qCDebug(dcAirConditioning()) << "Applied" << mutations.count() << "mutations to" << changedZones.count() << "zones";
+    for (auto it = changedZones.constBegin(); it != changedZones.constEnd(); ++it) {
+        scheduleZoneSave(it.key());
+        notifyZoneChanged(it.key(), it.value());
+        scheduleZoneUpdate(it.key());
+    }
+    return AirConditioningErrorNoError;
+}
+
+AirConditioningManager::AirConditioningError AirConditioningManager::zoneHistory(const QUuid &zoneId, const QDateTime &from, const QDateTime &to, ZoneHistory::Resolution resolution, ZoneHistoryEntries *entries) const
+{
+    if (!m_zones.contains(zoneId)) {
+        return AirConditioningErrorZoneNotFound;
+    }
+    if (!from.isValid() || !to.isValid() || from > to) {
+        return AirConditioningErrorInvalidTimeSpec;
+    }
+    // Zones which haven't been evaluated yet have no history
+    auto it = m_zoneHistories.constFind(zoneId);
+    *entries = it != m_zoneHistories.constEnd() ? it->entries(from, to, resolution) : ZoneHistoryEntries();
+    return AirConditioningErrorNoError;
+}
+
+int AirConditioningManager::coalescingInterval() const
+{
+    return m_coalescingTimer->interval();
+}
+
+void AirConditioningManager::setCoalescingInterval(int coalescingInterval)
+{
+    m_coalescingTimer->setInterval(qMax(0, coalescingInterval));
+    QSettings settings(settingsFileName(m_settingsPath), QSettings::IniFormat);
+    settings.setValue("coalescingInterval", m_coalescingTimer->interval());
+}
+
+quint64 AirConditioningManager::coalescedEvaluations() const
+{
+    return m_coalescedEvaluations;
+}
+
+QList<AirConditioningManager::ActuationStats> AirConditioningManager::actuationStats() const
+{
+    QList<ActuationStats> ret;
+    foreach (const auto &steps, m_actuationStats) {
+        ret.append(steps.values());
+    }
+    return ret;
+}
+
+int AirConditioningManager::saveInterval() const
+{
+    return m_saveTimer->interval();
+}
+
+void AirConditioningManager::setSaveInterval(int saveInterval)
+{
+    m_saveTimer->setInterval(qMax(0, saveInterval));
+    QSettings settings(settingsFileName(m_settingsPath), QSettings::IniFormat);
+    settings.setValue("saveInterval", m_saveTimer->interval());
+}
+
 void AirConditioningManager::onThingAdded(Thing *thing)
 {
-    if (thing->thingClass().interfaces().contains("thermostat")) {
+    Capabilities capabilities = thingClassInfo(thing).capabilities;
+    if (capabilities.testFlag(CapabilityThermostat)) {
         qCInfo(dcAirConditioning()) << "Thermostat added:" << thing;
-        m_thermostats.insert(thing->id(), new Thermostat(m_thingManager, thing, this));
+        addThermostat(thing);
     }
-    if (thing->thingClass().interfaces().contains("notifications")) {
+    if (capabilities.testFlag(CapabilityNotifications)) {
         qCInfo(dcAirConditioning()) << "Notifications added:" << thing;
-        m_notifications.insert(thing->id(), new Notifications(m_thingManager, thing, this));
+        Notifications *notifications = new Notifications(m_things, thing, m_clock, this);
+        connect(notifications, &Notifications::nextRearmChanged, this, &AirConditioningManager::requestWakeup);
+        m_notifications.insert(thing->id(), notifications);
     }
+    // Zones may have been waiting for this thing
+    rebindZones(thing->id());
 }
 
-void AirConditioningManager::onThingRemoved(const ThingId &thingId)
+void AirConditioningManager::onThingChanged(Thing *thing)
 {
-    foreach (const ZoneInfo &zone, m_zones) {
-        QList<ThingId> thermostats = m_zones.value(zone.id()).thermostats();
-        QList<ThingId> valves = m_zones.value(zone.id()).valves();
-        QList<ThingId> windowSensors = m_zones.value(zone.id()).windowSensors();
-        QList<ThingId> indoorSensors = m_zones.value(zone.id()).indoorSensors();
-        QList<ThingId> outdoorSensors = m_zones.value(zone.id()).outdoorSensors();
-        QList<ThingId> notifications = m_zones.value(zone.id()).notifications();
-        bool changed = false;
-        if (thermostats.contains(thingId)) {
-            thermostats.removeAll(thingId);
-            changed = true;
-        }
-        if (valves.contains(thingId)) {
-            valves.removeAll(thingId);
-            changed = true;
-        }
-        if (windowSensors.contains(thingId)) {
-            windowSensors.removeAll(thingId);
-            changed = true;
-        }
-        if (indoorSensors.contains(thingId)) {
-            indoorSensors.removeAll(thingId);
-            changed = true;
-        }
-        if (outdoorSensors.contains(thingId)) {
-            outdoorSensors.removeAll(thingId);
-            changed = true;
+    // The thing may have been reconfigured with an updated thing class, resolve all types again
+    m_thingClassInfos.remove(thing->thingClassId());
+    cacheThingClass(thing->thingClass());
+    if (m_thermostats.contains(thing->id())) {
+        m_thermostats.value(thing->id())->updateTypes();
+    }
+    if (m_notifications.contains(thing->id())) {
+        m_notifications.value(thing->id())->updateTypes();
+    }
+    rebindZones(thing->id());
+}
+
+void AirConditioningManager::addThermostat(Thing *thing)
+{
+    Thermostat *thermostat = new Thermostat(m_things, thing, this);
+    ThingClass thingClass = thing->thingClass();
+    connect(thermostat, &Thermostat::actuationStepFinished, this, [this, thingClass](const QString &step, bool success, qint64 duration){
+        ActuationStats &stats = m_actuationStats[thingClass.id()][step];
+        stats.thingClassId = thingClass.id();
+        stats.step = step;
+        stats.count++;
+        if (!success) {
+            stats.failures++;
         }
-        if (notifications.contains(thingId)) {
-            notifications.removeAll(thingId);
-            changed = true;
+        stats.totalDuration += duration;
+        stats.maxDuration = qMax(stats.maxDuration, duration);
+        qCDebug(dcAirConditioning()) << "Window open step" << step << "on" << thingClass.name() << (success ? "succeeded" : "failed") << "after" << duration << "ms."
+                                     << "Average:" << stats.totalDuration / stats.count << "ms, max:" << stats.maxDuration << "ms, failures:" << stats.failures << "of" << stats.count;
+    });
+    m_thermostats.insert(thing->id(), thermostat);
+}
+
+void AirConditioningManager::onThingRemoved(const ThingId &thingId)
+{
+    // Take the thing out of its zones in place. Rebinding would reset the smoothed readings
+    // of the remaining sensors.
+    const QHash<QUuid, ZoneRoles> memberships = m_zoneMemberships.take(thingId);
+    Thermostat *thermostat = m_thermostats.value(thingId);
+    Notifications *notifications = m_notifications.value(thingId);
+    for (auto it = memberships.constBegin(); it != memberships.constEnd(); ++it) {
+        const QUuid zoneId = it.key();
+        ZoneInfo &zone = m_zones[zoneId];
+        zone.setThermostats(withoutThing(zone.thermostats(), thingId));
+        zone.setValves(withoutThing(zone.valves(), thingId));
+        zone.setWindowSensors(withoutThing(zone.windowSensors(), thingId));
+        zone.setIndoorSensors(withoutThing(zone.indoorSensors(), thingId));
+        zone.setOutdoorSensors(withoutThing(zone.outdoorSensors(), thingId));
+        zone.setNotifications(withoutThing(zone.notifications(), thingId));
+        qCDebug(dcAirConditioning()) << "Removing thing" << thingId << "from zone" << zone.name();
+
+        ZoneBinding &binding = m_zoneBindings[zoneId];
+        binding.thermostats.removeAll(thermostat);
+        binding.notifications.removeAll(notifications);
+        for (QList<BoundThing> *boundThings : {&binding.thermostatThings, &binding.windowSensors, &binding.indoorSensors}) {
+            for (int i = boundThings->count() - 1; i >= 0; i--) {
+                if (boundThings->at(i).thing->id() == thingId) {
+                    boundThings->removeAt(i);
+                }
+            }
         }
-        if (changed) {
-            setZoneThings(zone.id(), thermostats, valves, windowSensors, indoorSensors, outdoorSensors, notifications);
+        ZoneAggregates &aggregates = m_zoneAggregates[zoneId];
+        for (SensorAggregate *aggregate : {&aggregates.thermostatTemperature, &aggregates.temperature, &aggregates.humidity, &aggregates.voc, &aggregates.pm25}) {
+            aggregate->removeValue(thingId);
         }
+
+        scheduleZoneSave(zoneId);
+        notifyZoneChanged(zoneId, ZoneInfo::ZoneFieldThings);
+        scheduleZoneUpdate(zoneId);
     }
+
+    // No zone is bound to them any more
+    delete m_thermostats.take(thingId);
+    delete m_notifications.take(thingId);
 }
 
 void AirConditioningManager::onThingStateChaged(Thing *thing, const StateTypeId &stateTypeId, const QVariant &value, const QVariant &minValue, const QVariant &maxValue)
@@ -271,23 +517,38 @@ void AirConditioningManager::onThingStateChaged(Thing *thing, const StateTypeId
     Q_UNUSED(minValue)
     Q_UNUSED(maxValue)
 
-    StateType stateType = thing->thingClass().getStateType(stateTypeId);
-    foreach (const ZoneInfo &zone, m_zones) {
+    QHash<ThingId, QHash<QUuid, ZoneRoles>>::const_iterator memberships = m_zoneMemberships.constFind(thing->id());
+    if (memberships == m_zoneMemberships.constEnd()) {
+        // Not part of any zone
+        return;
+    }
+
+    StateRole role = stateRole(thing, stateTypeId);
+    if (role == StateRoleNone) {
+        return;
+    }
+
+    Capabilities capabilities = thingClassInfo(thing).capabilities;
+    const QHash<QUuid, ZoneRoles> zoneRoles = memberships.value();
+    for (auto it = zoneRoles.constBegin(); it != zoneRoles.constEnd(); ++it) {
+        const ZoneInfo zone = m_zones.value(it.key());
+        ZoneRoles roles = it.value();
+        aggregateReading(&m_zoneAggregates[zone.id()], roles, thing->id(), capabilities, role, value.toDouble());
         bool changed = false;
-        if (zone.windowSensors().contains(thing->id()) && stateType.name() == "closed") {
+        if (roles.testFlag(ZoneRoleWindowSensor) && role == StateRoleClosed) {
             qCDebug(dcAirConditioning()) << "Window sensor in zone" << zone.name() << "changed" << value;
             changed = true;
         }
-        if (zone.thermostats().contains(thing->id()) && stateType.name() == "temperature") {
+        if (roles.testFlag(ZoneRoleThermostat) && role == StateRoleTemperature) {
             qCDebug(dcAirConditioning()) << "Thermostat temperature sensor in zone" << zone.name() << "changed" << value;
             changed = true;
         }
-        if (zone.indoorSensors().contains(thing->id()) && QStringList{"temperature", "humidity", "voc", "pm25"}.contains(stateType.name())) {
-            qCDebug(dcAirConditioning()) << "Sensor for" << stateType.name() << "in zone" << zone.name() << "changed" << value;
+        if (roles.testFlag(ZoneRoleIndoorSensor) && role != StateRoleClosed) {
+            qCDebug(dcAirConditioning()) << "Sensor for" << thing->thingClass().getStateType(stateTypeId).name() << "in zone" << zone.name() << "changed" << value;
             changed = true;
         }
         if (changed) {
-            updateZone(zone.id());
+            scheduleZoneUpdate(zone.id());
         }
     }
 }
@@ -295,13 +556,19 @@ void AirConditioningManager::onThingStateChaged(Thing *thing, const StateTypeId
 void AirConditioningManager::onActionExecuted(const Action &action, Thing::ThingError status)
 {
     if (action.triggeredBy() == Action::TriggeredByUser && status == Thing::ThingErrorNoError) {
-        Thing *thing = m_thingManager->findConfiguredThing(action.thingId());
-        if (thing && thing->thingClass().interfaces().contains("thermostat")) {
+        if (!m_zoneMemberships.contains(action.thingId())) {
+            return;
+        }
+        Thing *thing = m_things->findConfiguredThing(action.thingId());
+        if (thing && thingClassInfo(thing).capabilities.testFlag(CapabilityThermostat)) {
             if (thing->thingClass().actionTypes().findById(action.actionTypeId()).name() == "targetTemperature") {
-                foreach (const ZoneInfo &zone, m_zones) {
-                    if (zone.thermostats().contains(thing->id())) {
+                const QHash<QUuid, ZoneRoles> zoneRoles = m_zoneMemberships.value(thing->id());
+                for (auto it = zoneRoles.constBegin(); it != zoneRoles.constEnd(); ++it) {
+                    if (it.value().testFlag(ZoneRoleThermostat)) {
+                        const ZoneInfo zone = m_zones.value(it.key());
                         qCInfo(dcAirConditioning()).nospace() << "Target temperature changed on thermostat in zone " << zone.name() << ". Activating setpoint override for" << action.paramValue(action.actionTypeId()).toDouble();
                         m_zones[zone.id()].setSetpointOverride(action.paramValue(action.actionTypeId()).toDouble(), ZoneInfo::SetpointOverrideModeEventual);
+                        notifyZoneChanged(zone.id(), ZoneInfo::ZoneFieldSetpointOverride);
                     }
                 }
             }
@@ -313,60 +580,199 @@ void AirConditioningManager::update()
 {
     qCDebug(dcAirConditioning()) << "Upadting air conditioning";
     foreach (const QUuid &zoneId, m_zones.keys()) {
-        updateZone(zoneId);
+        scheduleZoneUpdate(zoneId);
+    }
+}
+
+void AirConditioningManager::scheduleZoneUpdate(const QUuid &zoneId)
+{
+    if (m_dirtyZones.contains(zoneId)) {
+        m_coalescedEvaluations++;
+        return;
+    }
+    m_dirtyZones.insert(zoneId);
+    if (!m_coalescingTimer->isActive()) {
+        m_coalescingTimer->start();
     }
 }
 
+AirConditioningManager::AirConditioningError AirConditioningManager::validateWeekSchedule(const TemperatureWeekSchedule &weekSchedule, ScheduleConflicts *conflicts) const
+{
+    if (weekSchedule.count() != 7) {
+        qCWarning(dcAirConditioning()) << "There must be exactly 7 schedules in a week schedule:" << weekSchedule;
+        return AirConditioningErrorInvalidTimeSpec;
+    }
+    ScheduleConflicts scheduleConflicts = weekSchedule.validate();
+    if (!scheduleConflicts.isEmpty()) {
+        foreach (const ScheduleConflict &conflict, scheduleConflicts) {
+            qCWarning(dcAirConditioning()) << "Invalid time spec:" << conflict;
+        }
+        if (conflicts) {
+            *conflicts = scheduleConflicts;
+        }
+        return AirConditioningErrorInvalidTimeSpec;
+    }
+    return AirConditioningErrorNoError;
+}
+
+void AirConditioningManager::applySetpointOverride(const QUuid &zoneId, double setpoint, ZoneInfo::SetpointOverrideMode mode, uint minutes)
+{
+    m_zones[zoneId].setSetpointOverride(setpoint, mode, m_clock->now().addMSecs(minutes * 60000));
+    m_eventualOverrideCache[zoneId] = (m_zones[zoneId].zoneStatus() | ZoneInfo::ZoneStatusFlagSetpointOverrideActive);
+    qCDebug(dcAirConditioning()) << "Memorizing zone status:" << m_eventualOverrideCache.value(zoneId);
+}
+
+void AirConditioningManager::notifyZoneChanged(const QUuid &zoneId, ZoneInfo::ZoneFields changedFields)
+{
+    m_zones[zoneId].setRevision(++m_revision);
+    emit zoneChanged(m_zones.value(zoneId), changedFields);
+}
+
+void AirConditioningManager::flushDirtyZones()
+{
+    QSet<QUuid> dirtyZones;
+    dirtyZones.swap(m_dirtyZones);
+    qCDebug(dcAirConditioning()) << "Evaluating" << dirtyZones.count() << "zones." << m_coalescedEvaluations << "evaluations coalesced so far.";
+    foreach (const QUuid &zoneId, dirtyZones) {
+        // Might have been removed in the meantime
+        if (m_zones.contains(zoneId)) {
+            updateZone(zoneId);
+        }
+    }
+    requestWakeup();
+}
+
+void AirConditioningManager::onWakeup()
+{
+    QDateTime now = m_clock->now();
+
+    while (!m_deadlines.isEmpty() && m_deadlines.firstKey() <= now) {
+        QUuid zoneId = m_deadlines.first();
+        setZoneDeadline(zoneId, QDateTime());
+        scheduleZoneUpdate(zoneId);
+    }
+
+    for (auto it = m_notifications.constBegin(); it != m_notifications.constEnd(); ++it) {
+        Notifications *notifications = it.value();
+        QDateTime rearm = notifications->nextRearm();
+        if (!rearm.isValid() || rearm > now) {
+            continue;
+        }
+        notifications->rearm(now);
+        // Give the zones a chance to show the warning again if it's still relevant
+        const QHash<QUuid, ZoneRoles> zoneRoles = m_zoneMemberships.value(it.key());
+        for (auto zoneIt = zoneRoles.constBegin(); zoneIt != zoneRoles.constEnd(); ++zoneIt) {
+            if (zoneIt.value().testFlag(ZoneRoleNotifications)) {
+                notifications->update(m_zones.value(zoneIt.key()));
+            }
+        }
+    }
+
+    requestWakeup();
+}
+
+QDateTime AirConditioningManager::nextZoneDeadline(const ZoneInfo &zone, const QDateTime &now) const
+{
+    QDateTime deadline = zone.compiledWeekSchedule().nextTransition(now);
+    if (zone.setpointOverrideMode() == ZoneInfo::SetpointOverrideModeTimed && zone.setpointOverrideEnd() > now) {
+        if (!deadline.isValid() || zone.setpointOverrideEnd() < deadline) {
+            deadline = zone.setpointOverrideEnd();
+        }
+    }
+    return deadline;
+}
+
+bool AirConditioningManager::debounceStatusFlag(const ZoneInfo &zone, ZoneInfo::ZoneStatusFlag flag, bool enter, bool exit, const QDateTime &now, QDateTime *recheck) const
+{
+    bool active = zone.zoneStatus().testFlag(flag);
+    bool wanted = active ? !exit : enter;
+    if (wanted == active) {
+        return active;
+    }
+
+    QDateTime changed = m_statusFlagChanges.value(zone.id()).value(flag);
+    if (changed.isValid() && changed.addSecs(statusFlagDwellTime) > now) {
+        QDateTime dwellEnd = changed.addSecs(statusFlagDwellTime);
+        qCDebug(dcAirConditioning()) << "Holding" << flag << "in zone" << zone.name() << "until" << dwellEnd;
+        if (!recheck->isValid() || dwellEnd < *recheck) {
+            *recheck = dwellEnd;
+        }
+        return active;
+    }
+    return wanted;
+}
+
+void AirConditioningManager::setZoneDeadline(const QUuid &zoneId, const QDateTime &deadline)
+{
+    QDateTime oldDeadline = m_zoneDeadlines.take(zoneId);
+    if (oldDeadline.isValid()) {
+        m_deadlines.remove(oldDeadline, zoneId);
+    }
+    if (deadline.isValid()) {
+        m_zoneDeadlines.insert(zoneId, deadline);
+        m_deadlines.insert(deadline, zoneId);
+    }
+}
+
+void AirConditioningManager::requestWakeup()
+{
+    QDateTime next;
+    if (!m_deadlines.isEmpty()) {
+        next = m_deadlines.firstKey();
+    }
+    foreach (Notifications *notifications, m_notifications) {
+        QDateTime rearm = notifications->nextRearm();
+        if (rearm.isValid() && (!next.isValid() || rearm < next)) {
+            next = rearm;
+        }
+    }
+
+    QDateTime now = m_clock->now();
+    qint64 interval = maxUpdateInterval;
+    if (next.isValid()) {
+        interval = qBound<qint64>(0, now.msecsTo(next), maxUpdateInterval);
+    }
+    qCDebug(dcAirConditioning()) << "Next evaluation due at" << next.toString() << "Waking up in" << interval << "ms";
+    m_clock->requestWakeup(now.addMSecs(interval));
+}
+
 void AirConditioningManager::updateZone(const QUuid &zoneId)
 {
     ZoneInfo zone = m_zones.value(zoneId);
     qCDebug(dcAirConditioning()) << "*** Evaluating Zone:" << zone.name();
 
-    QDateTime now = QDateTime::currentDateTime();
+    QDateTime now = m_clock->now();
+    setZoneDeadline(zoneId, nextZoneDeadline(zone, now));
 
     bool timeScheduleActive = false;
     bool overrideActive = false;
 
     qCDebug(dcAirConditioning()) << "Standby temp:" << zone.standbySetpoint() << "Override:" << zone.setpointOverrideMode() << zone.setpointOverride() << zone.setpointOverrideEnd().toString() << "Schedules:" << zone.weekSchedule();
 
-    if (zone.setpointOverrideMode() == ZoneInfo::SetpointOverrideModeUnlimited
-            || (zone.setpointOverrideMode() == ZoneInfo::SetpointOverrideModeTimed && zone.setpointOverrideEnd() > now)
-            || zone.setpointOverrideMode() == ZoneInfo::SetpointOverrideModeEventual) {
+    if (zone.setpointOverrideActive(now)) {
         qCDebug(dcAirConditioning()) << "Setpoint override active until" << zone.setpointOverrideEnd();
         overrideActive = true;
     }
 
-    TemperatureDaySchedule daySchedule = zone.weekSchedule().at(now.date().dayOfWeek() - 1);
-    double timeScheduleTemp;
-    foreach (const TemperatureSchedule &schedule, daySchedule) {
-        if (schedule.startTime() < now.time() && schedule.endTime() > now.time()) {
-            qCDebug(dcAirConditioning()) << "Schedule is active:" << schedule;
-            timeScheduleTemp = schedule.temperature();
-            timeScheduleActive = true;
-            break;
-        }
+    double timeScheduleTemp = 0;
+    const CompiledWeekSchedule::Slot *activeSlot = zone.compiledWeekSchedule().activeSlot(CompiledWeekSchedule::secondOfWeek(now));
+    if (activeSlot) {
+        qCDebug(dcAirConditioning()) << "Schedule is active with temperature" << activeSlot->temperature;
+        timeScheduleTemp = activeSlot->temperature;
+        timeScheduleActive = true;
     }
 
     // Checking window open
+    const ZoneBinding binding = m_zoneBindings.value(zoneId);
     bool windowOpen = false;
-    foreach (const ThingId &thingId, zone.thermostats()) {
-        Thing *thing = m_thingManager->findConfiguredThing(thingId);
-        if (!thing) {
-            qCWarning(dcAirConditioning()) << "Thing" << thingId << "seems to have been removed from the system!";
-            continue;
-        }
-        if (thing->hasState("windowOpenDetected") && thing->stateValue("windowOpenDetected").toBool()) {
+    foreach (const BoundThing &bound, binding.thermostatThings) {
+        if (bound.info.capabilities.testFlag(CapabilityWindowOpenDetection) && bound.thing->stateValue(bound.info.windowOpenDetectedStateTypeId).toBool()) {
             windowOpen = true;
             break;
         }
     }
-    foreach (const ThingId &thingId, zone.windowSensors()) {
-        Thing *thing = m_thingManager->findConfiguredThing(thingId);
-        if (!thing) {
-            qCWarning(dcAirConditioning()) << "Thing" << thingId << "seems to have been removed from the system!";
-            continue;
-        }
-        if (!thing->stateValue("closed").toBool()) {
+    foreach (const BoundThing &bound, binding.windowSensors) {
+        if (!bound.thing->stateValue(bound.info.closedStateTypeId).toBool()) {
             qCInfo(dcAirConditioning()) << "Window open.";
             windowOpen = true;
             break;
@@ -385,294 +791,378 @@ void AirConditioningManager::updateZone(const QUuid &zoneId)
 
     qCDebug(dcAirConditioning()) << "Window open" << windowOpen << "Override active:" << overrideActive << "Time schedule active:" << timeScheduleActive << "target:" << targetTemp;
 
-    // To determine the zone temperature we'll first check the thermostats if they have a temp sensor and use the highest value
-    // If no thermstats with temp sensors are available, we'll use the highest temp value from the indoor sensors.
-    bool tempFromThermostat = false;
-    bool tempFromSensors = false;
-    double temperature = 0;
-
-    foreach (const ThingId &thingId, zone.thermostats()) {
-        Thermostat *thermostat = m_thermostats.value(thingId);
-        if (thermostat) {
-            qCDebug(dcAirConditioning()) << "Setting window open" << windowOpen << " and target temp" << targetTemp;
-            thermostat->setWindowOpen(windowOpen);
-            thermostat->setTargetTemperature(targetTemp);
-
-            if (thermostat->hasTemperatureSensor()) {
-                qCDebug(dcAirConditioning()) << "Thermostat has temperature sensor:" << thermostat->temperature();
-                if (!tempFromThermostat) {
-                    temperature = thermostat->temperature();
-                    tempFromThermostat = true;
-                }
-                temperature = qMax(temperature, thermostat->temperature());
-            }
-        }
+    foreach (Thermostat *thermostat, binding.thermostats) {
+        qCDebug(dcAirConditioning()) << "Setting window open" << windowOpen << " and target temp" << targetTemp;
+        thermostat->setWindowOpen(windowOpen);
+        thermostat->setTargetTemperature(targetTemp);
     }
 
-    double humidity = 0;
-    uint voc = 0;
-    double pm25 = 0;
-
-    foreach (const ThingId &thingId, zone.indoorSensors()) {
-        Thing *thing = m_thingManager->findConfiguredThing(thingId);
-
-        if (!tempFromThermostat) {
-            if (thing->thingClass().interfaces().contains("temperaturesensor")) {
-                if (!tempFromSensors) {
-                    temperature = thing->stateValue("temperature").toDouble();
-                    tempFromSensors = true;
-                } else {
-                    temperature = qMax(temperature, thing->stateValue("temperature").toDouble());
-                }
-            }
-        }
-
-        if (thing->thingClass().interfaces().contains("humiditysensor")) {
-            humidity = qMax(humidity, thing->stateValue("humidity").toDouble());
-        }
-
-        if (thing->thingClass().interfaces().contains("vocsensor")) {
-            voc = qMax(voc, thing->stateValue("voc").toUInt());
-        }
-
-        if (thing->thingClass().interfaces().contains("pm25sensor")) {
-            pm25 = qMax(pm25, thing->stateValue("pm25").toDouble());
-        }
+    // To determine the zone temperature we'll first check the thermostats if they have a temp sensor and aggregate those
+    // If no thermstats with temp sensors are available, we'll aggregate the temp values from the indoor sensors.
+    // By default, the highest value is used.
+    const ZoneAggregates &aggregates = m_zoneAggregates[zoneId];
+    double temperature = 0;
+    if (!aggregates.thermostatTemperature.isEmpty()) {
+        temperature = aggregates.thermostatTemperature.value();
+    } else if (!aggregates.temperature.isEmpty()) {
+        temperature = aggregates.temperature.value();
     }
 
+    double humidity = qMax(0.0, aggregates.humidity.value());
+    uint voc = static_cast<uint>(qMax(0.0, aggregates.voc.value()));
+    double pm25 = qMax(0.0, aggregates.pm25.value());
+
     ZoneInfo::ZoneStatus newStatus = ZoneInfo::ZoneStatusFlagNone;
     newStatus.setFlag(ZoneInfo::ZoneStatusFlagWindowOpen, windowOpen);
     newStatus.setFlag(ZoneInfo::ZoneStatusFlagSetpointOverrideActive, overrideActive);
     newStatus.setFlag(ZoneInfo::ZoneStatusFlagTimeScheduleActive, timeScheduleActive);
-    newStatus.setFlag(ZoneInfo::ZoneStatusFlagHighHumidity, humidity >= 65); // > 60 over longer periods of time may cause mould, 70 will cause mould
-    newStatus.setFlag(ZoneInfo::ZoneStatusFlagBadAir, voc >= 660 || pm25 >= 25); // VOC: 660 Moderate as of IAQ, PM25: 25 Moderate as of CAQI
+
+    QDateTime recheck;
+    bool highHumidity = debounceStatusFlag(zone, ZoneInfo::ZoneStatusFlagHighHumidity, humidity >= highHumidityEnter, humidity < highHumidityExit, now, &recheck);
+    bool badAir = debounceStatusFlag(zone, ZoneInfo::ZoneStatusFlagBadAir, voc >= badAirVocEnter || pm25 >= badAirPm25Enter, voc < badAirVocExit && pm25 < badAirPm25Exit, now, &recheck);
+    newStatus.setFlag(ZoneInfo::ZoneStatusFlagHighHumidity, highHumidity);
+    newStatus.setFlag(ZoneInfo::ZoneStatusFlagBadAir, badAir);
+    if (recheck.isValid() && (!m_zoneDeadlines.contains(zoneId) || recheck < m_zoneDeadlines.value(zoneId))) {
+        setZoneDeadline(zoneId, recheck);
+    }
 
     if (zone.setpointOverrideMode() == ZoneInfo::SetpointOverrideModeEventual &&
             newStatus != m_eventualOverrideCache.value(zone.id())) {
         qCDebug(dcAirConditioning()) << "Zone status changed:" << m_eventualOverrideCache.value(zone.id()) << "->" << newStatus << "Resetting eventual override";
         m_zones[zone.id()].setSetpointOverride(zone.setpointOverride(), ZoneInfo::SetpointOverrideModeNone);
+        notifyZoneChanged(zone.id(), ZoneInfo::ZoneFieldSetpointOverride);
         updateZone(zone.id());
         return;
 
     }
 
-    if (targetTemp != zone.currentSetpoint()
-            || newStatus != zone.zoneStatus()
-            || temperature != zone.temperature()
-            || humidity != zone.humidity()
-            || voc != zone.voc()
-            || pm25 != zone.pm25()
-            ) {
+    ZoneInfo::ZoneFields changedFields = ZoneInfo::ZoneFieldNone;
+    changedFields.setFlag(ZoneInfo::ZoneFieldCurrentSetpoint, targetTemp != zone.currentSetpoint());
+    changedFields.setFlag(ZoneInfo::ZoneFieldZoneStatus, newStatus != zone.zoneStatus());
+    changedFields.setFlag(ZoneInfo::ZoneFieldTemperature, temperature != zone.temperature());
+    changedFields.setFlag(ZoneInfo::ZoneFieldHumidity, humidity != zone.humidity());
+    changedFields.setFlag(ZoneInfo::ZoneFieldVoc, voc != zone.voc());
+    changedFields.setFlag(ZoneInfo::ZoneFieldPm25, pm25 != zone.pm25());
+
+    if (changedFields != ZoneInfo::ZoneFieldNone) {
         qCDebug(dcAirConditioning()) << "Modifying Zone: setpoint:" << targetTemp << "status:" << newStatus << "temp:" << temperature << "humidity:" << humidity << "VOC:" << voc << "PM25:" << pm25;
         m_zones[zone.id()].setCurrentSetpoint(targetTemp);
         m_zones[zone.id()].setZoneStatus(newStatus);
+        for (ZoneInfo::ZoneStatusFlag flag : {ZoneInfo::ZoneStatusFlagHighHumidity, ZoneInfo::ZoneStatusFlagBadAir}) {
+            if (newStatus.testFlag(flag) != zone.zoneStatus().testFlag(flag)) {
+                m_statusFlagChanges[zone.id()][flag] = now;
+            }
+        }
         m_zones[zone.id()].setTemperature(temperature);
         m_zones[zone.id()].setHumidity(humidity);
         m_zones[zone.id()].setVoc(voc);
         m_zones[zone.id()].setPm25(pm25);
-        emit zoneChanged(m_zones.value(zone.id()));
+        notifyZoneChanged(zone.id(), changedFields);
 
-        foreach (const ThingId &notificationThingId, zone.notifications()) {
-            Notifications *notifications = m_notifications.value(notificationThingId);
-            if (!notifications) {
-                qCWarning(dcAirConditioning()) << "Stale notification thing id in zone!" << notificationThingId << m_notifications.keys();
-                continue;
-            }
+        foreach (Notifications *notifications, binding.notifications) {
             notifications->update(m_zones[zone.id()]);
         }
     }
+
+    m_zoneHistories[zoneId].record(now, m_zones.value(zoneId));
+    m_telemetry->record(now, m_zones.value(zoneId));
 }
 
 void AirConditioningManager::loadZones()
 {
     qCDebug(dcAirConditioning()) << "Loading zones";
-    QSettings settings(NymeaSettings::settingsPath() + "/airconditioning.conf", QSettings::IniFormat);
-
-    settings.beginGroup("zones");
-    qCDebug(dcAirConditioning()) << "child groups of zones" << settings.childKeys() << settings.childGroups();
-    foreach (const QString &key, settings.childGroups()) {
-        settings.beginGroup(key);
-        qCDebug(dcAirConditioning()) << "Loading zone" << key;
-        QUuid zoneId(key);
-        ZoneInfo zone(zoneId);
-        zone.setName(settings.value("name").toString());
-        QMetaEnum modeEnum = QMetaEnum::fromType<ZoneInfo::SetpointOverrideMode>();
-        ZoneInfo::SetpointOverrideMode mode = static_cast<ZoneInfo::SetpointOverrideMode>(modeEnum.keyToValue(settings.value("setpointOverrideMode", "SetpointOverrideModeNone").toByteArray()));
-        zone.setSetpointOverride(settings.value("setpointOverride").toDouble(), mode, settings.value("setpointOverrideEnd").toDateTime());
-        zone.setStandbySetpoint(settings.value("standbySetpoint").toDouble());
-        settings.beginGroup("weekSchedule");
-        TemperatureWeekSchedule weekSchedule;
-        for (int day = 0; day < 7; day++) {
-            TemperatureDaySchedule daySchedule;
-            settings.beginGroup(QString::number(day));
-            foreach (const QString &childGroup, settings.childGroups()) {
-                settings.beginGroup(childGroup);
-                QTime startTime = settings.value("startTime").toTime();
-                QTime endTime = settings.value("endTime").toTime();
-                double temperature = settings.value("temperature").toDouble();
-                TemperatureSchedule schedule(startTime, endTime, temperature);
-                daySchedule.append(schedule);
-                settings.endGroup(); // schedule
-            }
-            weekSchedule.append(daySchedule);
-            settings.endGroup(); // daySchedule
-        }
-        settings.endGroup(); // weekSchedule
-        zone.setWeekSchedule(weekSchedule);
+    foreach (ZoneInfo zone, m_storage.load()) {
+        qCDebug(dcAirConditioning()) << "Zone Loaded:" << zone.name() << zone.thermostats() << zone.valves() << zone.notifications();
+        zone.setRevision(++m_revision);
+        m_zones.insert(zone.id(), zone);
+        indexZone(zone);
+    }
+}
+
+void AirConditioningManager::saveZones()
+{
+    m_saveTimer->stop();
+    if (m_unsavedZones.isEmpty()) {
+        return;
+    }
+
+    qCDebug(dcAirConditioning()) << "Saving" << m_unsavedZones.count() << "zones";
+    m_storage.save(m_zones, m_unsavedZones);
+    m_unsavedZones.clear();
+}
 
-        QList<ThingId> thermostats, valves, windowSensors, indoorSensors, outdoorSensors, notifications;
-        foreach (const QString &thingId, settings.value("thermostats").toStringList()) {
-            thermostats.append(ThingId(thingId));
+void AirConditioningManager::scheduleZoneSave(const QUuid &zoneId)
+{
+    m_unsavedZones.insert(zoneId);
+    // Don't restart the timer, a change must not be delayed forever by subsequent changes
+    if (!m_saveTimer->isActive()) {
+        m_saveTimer->start();
+    }
+}
+
+void AirConditioningManager::indexZone(const ZoneInfo &zone)
+{
+    foreach (const ThingId &thingId, zone.thermostats()) {
+        m_zoneMemberships[thingId][zone.id()] |= ZoneRoleThermostat;
+    }
+    foreach (const ThingId &thingId, zone.valves()) {
+        m_zoneMemberships[thingId][zone.id()] |= ZoneRoleValve;
+    }
+    foreach (const ThingId &thingId, zone.windowSensors()) {
+        m_zoneMemberships[thingId][zone.id()] |= ZoneRoleWindowSensor;
+    }
+    foreach (const ThingId &thingId, zone.indoorSensors()) {
+        m_zoneMemberships[thingId][zone.id()] |= ZoneRoleIndoorSensor;
+    }
+    foreach (const ThingId &thingId, zone.outdoorSensors()) {
+        m_zoneMemberships[thingId][zone.id()] |= ZoneRoleOutdoorSensor;
+    }
+    foreach (const ThingId &thingId, zone.notifications()) {
+        m_zoneMemberships[thingId][zone.id()] |= ZoneRoleNotifications;
+    }
+    bindZone(zone);
+}
+
+void AirConditioningManager::unindexZone(const ZoneInfo &zone)
+{
+    QList<ThingId> members = zone.thermostats() + zone.valves() + zone.windowSensors() + zone.indoorSensors() + zone.outdoorSensors() + zone.notifications();
+    foreach (const ThingId &thingId, members) {
+        QHash<ThingId, QHash<QUuid, ZoneRoles>>::iterator it = m_zoneMemberships.find(thingId);
+        if (it == m_zoneMemberships.end()) {
+            continue;
         }
-        zone.setThermostats(thermostats);
-        foreach (const QString &thingId, settings.value("valves").toStringList()) {
-            valves.append(ThingId(thingId));
+        it->remove(zone.id());
+        if (it->isEmpty()) {
+            m_zoneMemberships.erase(it);
         }
-        zone.setValves(valves);
-        foreach (const QString &thingId, settings.value("windowSensors").toStringList()) {
-            windowSensors.append(ThingId(thingId));
+    }
+    m_zoneBindings.remove(zone.id());
+    m_zoneAggregates.remove(zone.id());
+}
+
+void AirConditioningManager::bindZone(const ZoneInfo &zone)
+{
+    ZoneBinding binding;
+    QList<ThingId> missingThings;
+    foreach (const ThingId &thingId, zone.thermostats()) {
+        Thing *thing = m_things->findConfiguredThing(thingId);
+        Thermostat *thermostat = m_thermostats.value(thingId);
+        if (!thing || !thermostat) {
+            missingThings.append(thingId);
+            continue;
         }
-        zone.setWindowSensors(windowSensors);
-        foreach (const QString &thingId, settings.value("indoorSensors").toStringList()) {
-            indoorSensors.append(ThingId(thingId));
+        binding.thermostatThings.append({thing, thingClassInfo(thing)});
+        binding.thermostats.append(thermostat);
+    }
+    foreach (const ThingId &thingId, zone.windowSensors()) {
+        Thing *thing = m_things->findConfiguredThing(thingId);
+        if (!thing) {
+            missingThings.append(thingId);
+            continue;
         }
-        zone.setIndoorSensors(indoorSensors);
-        foreach (const QString &thingId, settings.value("outdoorSensors").toStringList()) {
-            outdoorSensors.append(ThingId(thingId));
+        binding.windowSensors.append({thing, thingClassInfo(thing)});
+    }
+    foreach (const ThingId &thingId, zone.indoorSensors()) {
+        Thing *thing = m_things->findConfiguredThing(thingId);
+        if (!thing) {
+            missingThings.append(thingId);
+            continue;
         }
-        zone.setOutdoorSensors(outdoorSensors);
-        foreach (const QString &thingId, settings.value("notifications").toStringList()) {
-            notifications.append(ThingId(thingId));
+        binding.indoorSensors.append({thing, thingClassInfo(thing)});
+    }
+    foreach (const ThingId &thingId, zone.notifications()) {
+        Notifications *notifications = m_notifications.value(thingId);
+        if (!notifications) {
+            missingThings.append(thingId);
+            continue;
         }
-        zone.setNotifications(notifications);
-
-        qCDebug(dcAirConditioning()) << "Zone Loaded:" << zone.thermostats() << zone.valves() << zone.notifications();
-        m_zones.insert(zoneId, zone);
-        settings.endGroup(); // zone
+        binding.notifications.append(notifications);
+    }
+    if (!missingThings.isEmpty()) {
+        qCWarning(dcAirConditioning()) << "Things" << missingThings << "of zone" << zone.name() << "seem to have been removed from the system!";
     }
-    settings.endGroup(); // zones
+    m_zoneBindings.insert(zone.id(), binding);
+
+    // Seed the aggregates with the current readings, from here on they're updated on state changes
+    ZoneAggregates aggregates;
+    aggregates.thermostatTemperature.setMode(zone.temperatureAggregation());
+    aggregates.temperature.setMode(zone.temperatureAggregation());
+    aggregates.humidity.setMode(zone.humidityAggregation());
+    aggregates.voc.setMode(zone.vocAggregation());
+    aggregates.pm25.setMode(zone.pm25Aggregation());
+    for (SensorAggregate *aggregate : {&aggregates.thermostatTemperature, &aggregates.temperature, &aggregates.humidity, &aggregates.voc, &aggregates.pm25}) {
+        aggregate->setFilter(zone.smoothingFilter(), zone.smoothingWindow());
+    }
+    foreach (const BoundThing &bound, binding.thermostatThings) {
+        aggregateReading(&aggregates, ZoneRoleThermostat, bound.thing->id(), bound.info.capabilities, StateRoleTemperature, bound.thing->stateValue(bound.info.temperatureStateTypeId).toDouble());
+    }
+    foreach (const BoundThing &bound, binding.indoorSensors) {
+        aggregateReading(&aggregates, ZoneRoleIndoorSensor, bound.thing->id(), bound.info.capabilities, StateRoleTemperature, bound.thing->stateValue(bound.info.temperatureStateTypeId).toDouble());
+        aggregateReading(&aggregates, ZoneRoleIndoorSensor, bound.thing->id(), bound.info.capabilities, StateRoleHumidity, bound.thing->stateValue(bound.info.humidityStateTypeId).toDouble());
+        aggregateReading(&aggregates, ZoneRoleIndoorSensor, bound.thing->id(), bound.info.capabilities, StateRoleVoc, bound.thing->stateValue(bound.info.vocStateTypeId).toDouble());
+        aggregateReading(&aggregates, ZoneRoleIndoorSensor, bound.thing->id(), bound.info.capabilities, StateRolePm25, bound.thing->stateValue(bound.info.pm25StateTypeId).toDouble());
+    }
+    m_zoneAggregates.insert(zone.id(), aggregates);
 }
 
-void AirConditioningManager::saveZones()
+void AirConditioningManager::aggregateReading(ZoneAggregates *aggregates, ZoneRoles roles, const ThingId &thingId, Capabilities capabilities, StateRole role, double value)
 {
-    qCDebug(dcAirConditioning()) << "Saving zones";
-    QSettings settings(NymeaSettings::settingsPath() + "/airconditioning.conf", QSettings::IniFormat);
-    settings.beginGroup("zones");
-    settings.clear();
-    foreach (const ZoneInfo &zone, m_zones) {
-        settings.beginGroup(zone.id().toString());
-        settings.setValue("name", zone.name());
-        settings.setValue("standbySetpoint", zone.standbySetpoint());
-        settings.setValue("setpointOverride", zone.setpointOverride());
-        QMetaEnum modeEnum = QMetaEnum::fromType<ZoneInfo::SetpointOverrideMode>();
-        settings.setValue("setpointOverrideMode", modeEnum.valueToKey(zone.setpointOverrideMode()));
-        settings.setValue("setpointOverrideEnd", zone.setpointOverrideEnd());
-
-        settings.beginGroup("weekSchedule");
-        for (int day = 0; day < 7; day++) {
-            settings.beginGroup(QString::number(day));
-            TemperatureDaySchedule daySchedule = zone.weekSchedule().at(day);
-            for (int i = 0; i < daySchedule.count(); i++) {
-                TemperatureSchedule schedule = daySchedule.at(i);
-                settings.beginGroup(QString::number(i));
-                settings.setValue("startTime", schedule.startTime());
-                settings.setValue("endTime", schedule.endTime());
-                settings.setValue("temperature", schedule.temperature());
-                settings.endGroup(); // schedule
-            }
-            settings.endGroup(); // daySchedule
+    switch (role) {
+    case StateRoleTemperature:
+        if (!capabilities.testFlag(CapabilityTemperatureSensor)) {
+            break;
         }
-        settings.endGroup(); // weekSchedule
-
-        QStringList thermostats, valves, windowSensors, indoorSensors, outdoorSensors, notifications;
-        foreach (const ThingId &thingId, zone.thermostats()) {
-            thermostats.append(thingId.toString());
+        if (roles.testFlag(ZoneRoleThermostat)) {
+            aggregates->thermostatTemperature.setValue(thingId, value);
         }
-        settings.setValue("thermostats", thermostats);
-        foreach (const ThingId &thingId, zone.valves()) {
-            valves.append(thingId.toString());
+        if (roles.testFlag(ZoneRoleIndoorSensor)) {
+            aggregates->temperature.setValue(thingId, value);
         }
-        settings.setValue("valves", valves);
-        foreach (const ThingId &thingId, zone.windowSensors()) {
-            windowSensors.append(thingId.toString());
+        break;
+    case StateRoleHumidity:
+        if (roles.testFlag(ZoneRoleIndoorSensor) && capabilities.testFlag(CapabilityHumiditySensor)) {
+            aggregates->humidity.setValue(thingId, value);
         }
-        settings.setValue("windowSensors", windowSensors);
-        foreach (const ThingId &thingId, zone.indoorSensors()) {
-            indoorSensors.append(thingId.toString());
+        break;
+    case StateRoleVoc:
+        if (roles.testFlag(ZoneRoleIndoorSensor) && capabilities.testFlag(CapabilityVocSensor)) {
+            aggregates->voc.setValue(thingId, value);
         }
-        settings.setValue("indoorSensors", indoorSensors);
-        foreach (const ThingId &thingId, zone.outdoorSensors()) {
-            outdoorSensors.append(thingId.toString());
+        break;
+    case StateRolePm25:
+        if (roles.testFlag(ZoneRoleIndoorSensor) && capabilities.testFlag(CapabilityPm25Sensor)) {
+            aggregates->pm25.setValue(thingId, value);
         }
-        settings.setValue("outdoorSensors", outdoorSensors);
+        break;
+    default:
+        break;
+    }
+}
+
+void AirConditioningManager::rebindZones(const ThingId &thingId)
+{
+    const QHash<QUuid, ZoneRoles> memberships = m_zoneMemberships.value(thingId);
+    for (auto it = memberships.constBegin(); it != memberships.constEnd(); ++it) {
+        bindZone(m_zones.value(it.key()));
+        scheduleZoneUpdate(it.key());
+    }
+}
+
+void AirConditioningManager::cacheThingClass(const ThingClass &thingClass)
+{
+    if (m_thingClassInfos.contains(thingClass.id())) {
+        return;
+    }
 
-        foreach (const ThingId &thingId, zone.notifications()) {
-            notifications.append(thingId.toString());
+    static const QHash<QString, Capability> interfaceCapabilities = {
+        {"thermostat", CapabilityThermostat},
+        {"valve", CapabilityValve},
+        {"closablesensor", CapabilityClosableSensor},
+        {"temperaturesensor", CapabilityTemperatureSensor},
+        {"humiditysensor", CapabilityHumiditySensor},
+        {"vocsensor", CapabilityVocSensor},
+        {"pm25sensor", CapabilityPm25Sensor},
+        {"notifications", CapabilityNotifications}
+    };
+    static const QHash<QString, StateRole> roleNames = {
+        {"closed", StateRoleClosed},
+        {"temperature", StateRoleTemperature},
+        {"humidity", StateRoleHumidity},
+        {"voc", StateRoleVoc},
+        {"pm25", StateRolePm25}
+    };
+
+    ThingClassInfo info;
+    foreach (const QString &interfaceName, thingClass.interfaces()) {
+        info.capabilities |= interfaceCapabilities.value(interfaceName, CapabilityNone);
+    }
+    foreach (const StateType &stateType, thingClass.stateTypes()) {
+        StateRole role = roleNames.value(stateType.name(), StateRoleNone);
+        if (role != StateRoleNone) {
+            info.stateRoles.insert(stateType.id(), role);
         }
-        settings.setValue("notifications", notifications);
+    }
+    info.closedStateTypeId = thingClass.stateTypes().findByName("closed").id();
+    info.temperatureStateTypeId = thingClass.stateTypes().findByName("temperature").id();
+    info.humidityStateTypeId = thingClass.stateTypes().findByName("humidity").id();
+    info.vocStateTypeId = thingClass.stateTypes().findByName("voc").id();
+    info.pm25StateTypeId = thingClass.stateTypes().findByName("pm25").id();
+    info.windowOpenDetectedStateTypeId = thingClass.stateTypes().findByName("windowOpenDetected").id();
+    if (!info.windowOpenDetectedStateTypeId.isNull()) {
+        info.capabilities |= CapabilityWindowOpenDetection;
+    }
+    m_thingClassInfos.insert(thingClass.id(), info);
+}
 
-        settings.endGroup(); // zone
+const AirConditioningManager::ThingClassInfo &AirConditioningManager::thingClassInfo(Thing *thing)
+{
+    QHash<ThingClassId, ThingClassInfo>::const_iterator it = m_thingClassInfos.constFind(thing->thingClassId());
+    if (it == m_thingClassInfos.constEnd()) {
+        cacheThingClass(thing->thingClass());
+        it = m_thingClassInfos.constFind(thing->thingClassId());
     }
-    settings.endGroup();
+    return it.value();
+}
 
+AirConditioningManager::StateRole AirConditioningManager::stateRole(Thing *thing, const StateTypeId &stateTypeId)
+{
+    return thingClassInfo(thing).stateRoles.value(stateTypeId, StateRoleNone);
 }
 
 AirConditioningManager::AirConditioningError AirConditioningManager::verifyThingIds(const QList<ThingId> &thermostats, const QList<ThingId> &valves, const QList<ThingId> &windowSensors, const QList<ThingId> &indoorSensors, const QList<ThingId> &outdoorSensors, const QList<ThingId> &notifications)
 {
     foreach (const QUuid &thingId, thermostats) {
-        Thing *thing = m_thingManager->findConfiguredThing(thingId);
+        Thing *thing = m_things->findConfiguredThing(thingId);
         if (!thing) {
             qCWarning(dcAirConditioning()) << "No thing with id" << thingId;
             return AirConditioningErrorThingNotFound;
         }
-        if (!thing->thingClass().interfaces().contains("thermostat")) {
+        if (!thingClassInfo(thing).capabilities.testFlag(CapabilityThermostat)) {
             qCWarning(dcAirConditioning()) << "Not a thermostat:" << thing->name();
             return AirConditioningErrorInvalidThingType;
         }
     }
     foreach (const QUuid &thingId, valves) {
-        Thing *thing = m_thingManager->findConfiguredThing(thingId);
+        Thing *thing = m_things->findConfiguredThing(thingId);
         if (!thing) {
             qCWarning(dcAirConditioning()) << "No thing with id" << thingId;
             return AirConditioningErrorThingNotFound;
         }
-        if (!thing->thingClass().interfaces().contains("valve")) {
+        if (!thingClassInfo(thing).capabilities.testFlag(CapabilityValve)) {
             qCWarning(dcAirConditioning()) << "Not a valve:" << thing->name();
             return AirConditioningErrorInvalidThingType;
         }
     }
     foreach (const QUuid &thingId, windowSensors) {
-        Thing *thing = m_thingManager->findConfiguredThing(thingId);
+        Thing *thing = m_things->findConfiguredThing(thingId);
         if (!thing) {
             qCWarning(dcAirConditioning()) << "No thing with id" << thingId;
             return AirConditioningErrorThingNotFound;
         }
-        if (!thing->thingClass().interfaces().contains("closablesensor")) {
+        if (!thingClassInfo(thing).capabilities.testFlag(CapabilityClosableSensor)) {
             qCWarning(dcAirConditioning()) << "Not a window sensor:" << thing->name();
             return AirConditioningErrorInvalidThingType;
         }
     }
     foreach (const QUuid &thingId, indoorSensors + outdoorSensors) {
-        Thing *thing = m_thingManager->findConfiguredThing(thingId);
+        Thing *thing = m_things->findConfiguredThing(thingId);
         if (!thing) {
             qCWarning(dcAirConditioning()) << "No thing with id" << thingId;
             return AirConditioningErrorThingNotFound;
         }
-        if (!thing->thingClass().interfaces().contains("temperaturesensor")
-                && !thing->thingClass().interfaces().contains("humiditysensor")
-                && !thing->thingClass().interfaces().contains("vocsensor")
-                && !thing->thingClass().interfaces().contains("pm25sensor")) {
+        Capabilities sensorCapabilities = Capabilities(CapabilityTemperatureSensor) | CapabilityHumiditySensor | CapabilityVocSensor | CapabilityPm25Sensor;
+        if (!(thingClassInfo(thing).capabilities & sensorCapabilities)) {
             qCWarning(dcAirConditioning()) << "Not a temperature, humidity, voc or pm25 sensor:" << thing->name();
             return AirConditioningErrorInvalidThingType;
         }
     }
     foreach (const QUuid &thingId, notifications) {
-        Thing *thing = m_thingManager->findConfiguredThing(thingId);
+        Thing *thing = m_things->findConfiguredThing(thingId);
         if (!thing) {
             qCWarning(dcAirConditioning()) << "No thing with id" << thingId;
             return AirConditioningErrorThingNotFound;
         }
-        if (!thing->thingClass().interfaces().contains("notifications")) {
+        if (!thingClassInfo(thing).capabilities.testFlag(CapabilityNotifications)) {
             qCWarning(dcAirConditioning()) << "Not a notification thing:" << thing->name();
             return AirConditioningErrorInvalidThingType;
         }
@@ -27,6 +27,8 @@
 
 #include <QObject>
 #include <QHash>
+#include <QMultiMap>
+#include <QSet>
 #include <QTimer>
 
 #include <integrations/thingmanager.h>
@@ -34,6 +36,12 @@
 #include "zoneinfo.h"
 #include "thermostat.h"
 #include "notifications.h"
+#include "zonestorage.h"
+#include "clock.h"
+#include "thingregistry.h"
+#include "sensoraggregate.h"
+#include "zonehistory.h"
+#include "zonetelemetry.h"
 
 class AirConditioningManager : public QObject
 {
@@ -44,11 +52,50 @@ public:
         AirConditioningErrorZoneNotFound,
         AirConditioningErrorInvalidTimeSpec,
         AirConditioningErrorThingNotFound,
-        AirConditioningErrorInvalidThingType
+        AirConditioningErrorInvalidThingType,
+        AirConditioningErrorInvalidParameter
     };
     Q_ENUM(AirConditioningError)
 
+    // A set of changes to a single zone, used to change many zones at once
+    struct ZoneMutation {
+        QUuid zoneId;
+        // Which of the values below to apply. Supported are name, standby setpoint, setpoint override and week schedule.
+        ZoneInfo::ZoneFields fields = ZoneInfo::ZoneFieldNone;
+        QString name;
+        double standbySetpoint = 0;
+        double setpointOverride = 0;
+        ZoneInfo::SetpointOverrideMode setpointOverrideMode = ZoneInfo::SetpointOverrideModeNone;
+        uint setpointOverrideMinutes = 0;
+        TemperatureWeekSchedule weekSchedule;
+    };
+
+    // Window open actuation latency of a thing class in one step, durations are in ms
+    struct ActuationStats {
+        ThingClassId thingClassId;
+        QString step;
+        int count = 0;
+        int failures = 0;
+        qint64 totalDuration = 0;
+        qint64 maxDuration = 0;
+    };
+
     explicit AirConditioningManager(ThingManager *thingManager, QObject *parent = nullptr);
+    // The manager takes ownership of the given things and clock. Zones and settings are stored in settingsPath.
+    AirConditioningManager(ThingRegistry *things, Clock *clock, const QString &settingsPath, QObject *parent = nullptr);
+    ~AirConditioningManager() override;
+
+    Clock *clock() const;
+    // Long term storage of zone readings and status transitions
+    ZoneTelemetry *telemetry() const;
+
+    // Increases with every change to any zone
+    quint64 revision() const;
+    // Changes with every restart, revisions of different epochs can't be compared
+    QUuid epoch() const;
+    // Fetches zones changed and ids of zones removed after sinceRevision. Returns false if the
+    // change log doesn't reach back that far and the caller needs to fetch all zones instead.
+    bool zoneChanges(quint64 sinceRevision, ZoneInfos *changedZones, QList<QUuid> *removedZones) const;
 
     ZoneInfos zones() const;
     ZoneInfo zone(const QUuid &thermostatId);
@@ -58,44 +105,194 @@ public:
     AirConditioningError setZoneName(const QUuid &zoneId, const QString &name);
     AirConditioningError setZoneStandbySetpoint(const QUuid &zoneId, double standbySetpoint);
     AirConditioningError setZoneSetpointOverride(const QUuid &zoneId, double setpoint, ZoneInfo::SetpointOverrideMode mode, uint minutes);
-    AirConditioningError setZoneWeekSchedules(const QUuid &zoneId, const TemperatureWeekSchedule &temperatureWeekSchedule);
+    AirConditioningError setZoneWeekSchedules(const QUuid &zoneId, const TemperatureWeekSchedule &temperatureWeekSchedule, ScheduleConflicts *conflicts = nullptr);
 
     AirConditioningError setZoneThings(const QUuid &zoneId, const QList<ThingId> &thermostats, const QList<ThingId> &valves, const QList<ThingId> &windowSensors, const QList<ThingId> &indoorSensors, const QList<ThingId> &outdoorSensors, const QList<ThingId> &notifications);
+    AirConditioningError setZoneAggregation(const QUuid &zoneId, ZoneInfo::AggregationMode temperatureAggregation, ZoneInfo::AggregationMode humidityAggregation, ZoneInfo::AggregationMode vocAggregation, ZoneInfo::AggregationMode pm25Aggregation, ZoneInfo::SmoothingFilter smoothingFilter, uint smoothingWindow);
+
+    // Applies either all mutations or none of them. Each affected zone is notified, saved and evaluated once.
+    // On error, failedIndex is set to the index of the offending mutation.
+    AirConditioningError applyZoneMutations(const QList<ZoneMutation> &mutations, int *failedIndex = nullptr, ScheduleConflicts *conflicts = nullptr);
+
+    // Recorded readings of a zone between from and to, served from memory. See ZoneHistory for how far back each resolution reaches.
+    AirConditioningError zoneHistory(const QUuid &zoneId, const QDateTime &from, const QDateTime &to, ZoneHistory::Resolution resolution, ZoneHistoryEntries *entries) const;
 //    AirConditioningError addThing(const QUuid &zoneId, const ThingId &thingId);
 //    AirConditioningError removeThing(const QUuid &zoneId, const ThingId &thingId);
 
+    // Zone evaluations are coalesced within this window (in ms). 0 evaluates once per event loop iteration.
+    // Persisted in airconditioning-settings.conf.
+    int coalescingInterval() const;
+    void setCoalescingInterval(int coalescingInterval);
+    // Number of zone evaluations saved by coalescing since startup.
+    quint64 coalescedEvaluations() const;
+    // Per thing class and window open step, since startup
+    QList<ActuationStats> actuationStats() const;
+
+    // Changed zones are written to disk at most this long (in ms) after the first change.
+    // Persisted in airconditioning-settings.conf.
+    int saveInterval() const;
+    void setSaveInterval(int saveInterval);
 
 signals:
     void zoneAdded(const ZoneInfo &zone);
     void zoneRemoved(const QUuid &zoneId);
-    void zoneChanged(const ZoneInfo &zoneInfo);
+    void zoneChanged(const ZoneInfo &zoneInfo, ZoneInfo::ZoneFields changedFields);
     void notificationThingsChanged(const QList<ThingId> &notificationThigns);
 
 private slots:
     void onThingAdded(Thing *thing);
+    void onThingChanged(Thing *thing);
     void onThingRemoved(const ThingId &thingId);
     void onThingStateChaged(Thing *thing, const StateTypeId &stateTypeId, const QVariant &value, const QVariant &minValue, const QVariant &maxValue);
     void onActionExecuted(const Action &action, Thing::ThingError status);
 
     void update();
     void updateZone(const QUuid &zoneId);
+    void flushDirtyZones();
+    void onWakeup();
+
+    void saveZones();
 
 private:
+    enum ZoneRole {
+        ZoneRoleNone = 0x00,
+        ZoneRoleThermostat = 0x01,
+        ZoneRoleValve = 0x02,
+        ZoneRoleWindowSensor = 0x04,
+        ZoneRoleIndoorSensor = 0x08,
+        ZoneRoleOutdoorSensor = 0x10,
+        ZoneRoleNotifications = 0x20
+    };
+    Q_DECLARE_FLAGS(ZoneRoles, ZoneRole)
+
+    enum StateRole {
+        StateRoleNone,
+        StateRoleClosed,
+        StateRoleTemperature,
+        StateRoleHumidity,
+        StateRoleVoc,
+        StateRolePm25
+    };
+
+    enum Capability {
+        CapabilityNone = 0x000,
+        CapabilityThermostat = 0x001,
+        CapabilityValve = 0x002,
+        CapabilityClosableSensor = 0x004,
+        CapabilityTemperatureSensor = 0x008,
+        CapabilityHumiditySensor = 0x010,
+        CapabilityVocSensor = 0x020,
+        CapabilityPm25Sensor = 0x040,
+        CapabilityNotifications = 0x080,
+        CapabilityWindowOpenDetection = 0x100
+    };
+    Q_DECLARE_FLAGS(Capabilities, Capability)
+
+    // Everything we need to know about a thing class, resolved once so evaluations don't compare any names
+    struct ThingClassInfo {
+        Capabilities capabilities = CapabilityNone;
+        QHash<StateTypeId, StateRole> stateRoles;
+        StateTypeId closedStateTypeId;
+        StateTypeId temperatureStateTypeId;
+        StateTypeId humidityStateTypeId;
+        StateTypeId vocStateTypeId;
+        StateTypeId pm25StateTypeId;
+        StateTypeId windowOpenDetectedStateTypeId;
+    };
+
+    struct BoundThing {
+        Thing *thing;
+        ThingClassInfo info;
+    };
+    // The member things of a zone, resolved when the zone's things or the configured things change
+    struct ZoneBinding {
+        QList<BoundThing> thermostatThings;
+        QList<Thermostat*> thermostats;
+        QList<BoundThing> windowSensors;
+        QList<BoundThing> indoorSensors;
+        QList<Notifications*> notifications;
+    };
+
+    // Latest readings of the zone's sensors, updated with every state change
+    struct ZoneAggregates {
+        SensorAggregate thermostatTemperature;
+        SensorAggregate temperature;
+        SensorAggregate humidity;
+        SensorAggregate voc;
+        SensorAggregate pm25;
+    };
+
+    void scheduleZoneUpdate(const QUuid &zoneId);
+    AirConditioningError validateWeekSchedule(const TemperatureWeekSchedule &weekSchedule, ScheduleConflicts *conflicts) const;
+    void applySetpointOverride(const QUuid &zoneId, double setpoint, ZoneInfo::SetpointOverrideMode mode, uint minutes);
+    void notifyZoneChanged(const QUuid &zoneId, ZoneInfo::ZoneFields changedFields);
+
+    QDateTime nextZoneDeadline(const ZoneInfo &zone, const QDateTime &now) const;
+    // Returns the debounced state of a status flag. If the flag should switch but has not been in its
+    // current state long enough, recheck is moved to the point in time when it may switch.
+    bool debounceStatusFlag(const ZoneInfo &zone, ZoneInfo::ZoneStatusFlag flag, bool enter, bool exit, const QDateTime &now, QDateTime *recheck) const;
+    void setZoneDeadline(const QUuid &zoneId, const QDateTime &deadline);
+    void requestWakeup();
+
+    void addThermostat(Thing *thing);
+
     void loadZones();
-    void saveZones();
+    void scheduleZoneSave(const QUuid &zoneId);
+
+    void indexZone(const ZoneInfo &zone);
+    void unindexZone(const ZoneInfo &zone);
+    void bindZone(const ZoneInfo &zone);
+    void rebindZones(const ThingId &thingId);
+    void aggregateReading(ZoneAggregates *aggregates, ZoneRoles roles, const ThingId &thingId, Capabilities capabilities, StateRole role, double value);
+
+    void cacheThingClass(const ThingClass &thingClass);
+    // The returned reference is valid until the next call
+    const ThingClassInfo &thingClassInfo(Thing *thing);
+    StateRole stateRole(Thing *thing, const StateTypeId &stateTypeId);
 
     AirConditioningError verifyThingIds(const QList<ThingId> &thermostats, const QList<ThingId> &valves, const QList<ThingId> &windowSensors, const QList<ThingId> &indoorSensors, const QList<ThingId> &outdoorSensors, const QList<ThingId> &notifications);
 
 private:
-    ThingManager *m_thingManager = nullptr;
-    QTimer *m_updateTimer = nullptr;
+    ThingRegistry *m_things = nullptr;
+    QString m_settingsPath;
+    ZoneStorage m_storage;
+    Clock *m_clock = nullptr;
+    QTimer *m_coalescingTimer = nullptr;
+    QTimer *m_saveTimer = nullptr;
+
+    QSet<QUuid> m_dirtyZones;
+    quint64 m_coalescedEvaluations = 0;
+
+    // Zones that changed or were removed since the last save
+    QSet<QUuid> m_unsavedZones;
 
     QHash<ThingId, Thermostat*> m_thermostats;
+
+    QHash<ThingClassId, QHash<QString, ActuationStats>> m_actuationStats;
     QHash<QUuid, ZoneInfo> m_zones;
+    quint64 m_revision = 0;
+    QUuid m_epoch;
+    // Revisions at which zones were removed, bounded to maxRemovedZones entries
+    QMap<quint64, QUuid> m_removedZones;
+    // Oldest revision zoneChanges() can still answer
+    quint64 m_changeLogStart = 0;
+    static const int maxRemovedZones = 256;
+    // Reverse index: which zones a thing is member of, and in which roles
+    QHash<ThingId, QHash<QUuid, ZoneRoles>> m_zoneMemberships;
+    QHash<QUuid, ZoneBinding> m_zoneBindings;
+    QHash<QUuid, ZoneAggregates> m_zoneAggregates;
+    // Capabilities and state types we're interested in, resolved once per thing class
+    QHash<ThingClassId, ThingClassInfo> m_thingClassInfos;
     QHash<QUuid, ZoneInfo::ZoneStatus> m_eventualOverrideCache;
+    // When debounced status flags have switched last
+    QHash<QUuid, QHash<ZoneInfo::ZoneStatusFlag, QDateTime>> m_statusFlagChanges;
     QHash<ThingId, Notifications*> m_notifications;
+    QHash<QUuid, ZoneHistory> m_zoneHistories;
+    ZoneTelemetry *m_telemetry = nullptr;
 
-    QDateTime m_lastUpdateTime;
+    // The next point in time at which a zone needs to be evaluated, e.g. a schedule or override ending
+    QHash<QUuid, QDateTime> m_zoneDeadlines;
+    QMultiMap<QDateTime, QUuid> m_deadlines;
 };
 
 #endif // AIRCONDITIONINGMANAGER_H
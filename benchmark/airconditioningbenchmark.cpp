@@ -0,0 +1,456 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-experience-plugin-airconditioning.
+*
+* nymea-experience-plugin-airconditioning is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-experience-plugin-airconditioning is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-experience-plugin-airconditioning. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QLoggingCategory>
+
+#include <atomic>
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#include "zoneinfo.h"
+#include "zonestorage.h"
+#include "airconditioningmanager.h"
+#include "fakethings.h"
+
+Q_LOGGING_CATEGORY(dcAirConditioning, "AirConditioning")
+
+// Counts heap allocations so the benchmarks can report allocations per operation
+static std::atomic<quint64> s_allocations(0);
+
+void *operator new(std::size_t size)
+{
+    s_allocations++;
+    void *ptr = std::malloc(size ? size : 1);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+// Records the duration of single operations and prints throughput, percentiles and allocations
+class LatencyRecorder
+{
+public:
+    explicit LatencyRecorder(const QString &name, int reserve): m_name(name) {
+        m_samples.reserve(reserve);
+        m_allocationsStart = s_allocations;
+        m_total.start();
+    }
+
+    void start() {
+        m_timer.start();
+    }
+    void stop() {
+        m_samples.append(m_timer.nsecsElapsed());
+    }
+
+    void report() {
+        qint64 totalNsecs = m_total.nsecsElapsed();
+        quint64 allocations = s_allocations - m_allocationsStart;
+        if (m_samples.isEmpty()) {
+            return;
+        }
+        std::sort(m_samples.begin(), m_samples.end());
+        qInfo().noquote().nospace() << m_name << ": "
+                                    << QString::number(m_samples.count() * 1e9 / qMax<qint64>(1, totalNsecs), 'f', 0) << " ops/s, "
+                                    << "p50 " << percentile(0.5) << " ns, "
+                                    << "p95 " << percentile(0.95) << " ns, "
+                                    << "p99 " << percentile(0.99) << " ns, "
+                                    << "max " << m_samples.last() << " ns, "
+                                    << QString::number(static_cast<double>(allocations) / m_samples.count(), 'f', 2) << " allocations/op";
+    }
+
+private:
+    qint64 percentile(double p) const {
+        int index = qMin(m_samples.count() - 1, static_cast<int>(p * m_samples.count()));
+        return m_samples.at(index);
+    }
+
+    QString m_name;
+    QVector<qint64> m_samples;
+    QElapsedTimer m_timer;
+    QElapsedTimer m_total;
+    quint64 m_allocationsStart = 0;
+};
+
+class AirConditioningBenchmark: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void scheduleLookup_data();
+    void scheduleLookup();
+
+    void scheduleValidation_data();
+    void scheduleValidation();
+
+    void storageLoad_data();
+    void storageLoad();
+
+    void storageSave_data();
+    void storageSave();
+
+    void stateChanges_data();
+    void stateChanges();
+
+    void simulatedWeek();
+
+private:
+    static TemperatureWeekSchedule createWeekSchedule(int slotsPerDay);
+    static QHash<QUuid, ZoneInfo> createZones(int zoneCount, int slotsPerDay, int thingsPerZone);
+};
+
+TemperatureWeekSchedule AirConditioningBenchmark::createWeekSchedule(int slotsPerDay)
+{
+    TemperatureWeekSchedule weekSchedule;
+    int slotLength = 24 * 60 / qMax(1, slotsPerDay);
+    for (int day = 0; day < 7; day++) {
+        TemperatureDaySchedule daySchedule;
+        // Every other slot is a gap
+        for (int i = 0; i < slotsPerDay; i += 2) {
+            QTime start = QTime(0, 0).addSecs(i * slotLength * 60);
+            QTime end = start.addSecs(slotLength * 60);
+            daySchedule.append(TemperatureSchedule(start, end, 18 + i % 5));
+        }
+        weekSchedule.append(daySchedule);
+    }
+    return weekSchedule;
+}
+
+QHash<QUuid, ZoneInfo> AirConditioningBenchmark::createZones(int zoneCount, int slotsPerDay, int thingsPerZone)
+{
+    QHash<QUuid, ZoneInfo> zones;
+    for (int i = 0; i < zoneCount; i++) {
+        ZoneInfo zone(QUuid::createUuid());
+        zone.setName(QString("Zone %1").arg(i));
+        zone.setWeekSchedule(createWeekSchedule(slotsPerDay));
+        QList<ThingId> thermostats, windowSensors, indoorSensors;
+        for (int j = 0; j < thingsPerZone; j++) {
+            thermostats.append(ThingId(QUuid::createUuid()));
+            windowSensors.append(ThingId(QUuid::createUuid()));
+            indoorSensors.append(ThingId(QUuid::createUuid()));
+        }
+        zone.setThermostats(thermostats);
+        zone.setWindowSensors(windowSensors);
+        zone.setIndoorSensors(indoorSensors);
+        zones.insert(zone.id(), zone);
+    }
+    return zones;
+}
+
+void AirConditioningBenchmark::initTestCase()
+{
+    // The manager logs every evaluation, which would dominate the measurements
+    QLoggingCategory::setFilterRules("AirConditioning.debug=false\nAirConditioning.info=false");
+}
+
+void AirConditioningBenchmark::scheduleLookup_data()
+{
+    QTest::addColumn<int>("zoneCount");
+    QTest::addColumn<int>("slotsPerDay");
+
+    QTest::newRow("100 zones, 4 slots") << 100 << 4;
+    QTest::newRow("1000 zones, 4 slots") << 1000 << 4;
+    QTest::newRow("1000 zones, 48 slots") << 1000 << 48;
+}
+
+void AirConditioningBenchmark::scheduleLookup()
+{
+    QFETCH(int, zoneCount);
+    QFETCH(int, slotsPerDay);
+
+    QList<ZoneInfo> zones = createZones(zoneCount, slotsPerDay, 1).values();
+    QDateTime now = QDateTime::currentDateTime();
+
+    // One tick evaluates the active slot and next deadline of every zone
+    LatencyRecorder recorder(QTest::currentDataTag(), 1000);
+    for (int tick = 0; tick < 1000; tick++) {
+        QDateTime time = now.addSecs(tick * 60);
+        recorder.start();
+        foreach (const ZoneInfo &zone, zones) {
+            const CompiledWeekSchedule::Slot *slot = zone.compiledWeekSchedule().activeSlot(CompiledWeekSchedule::secondOfWeek(time));
+            QDateTime next = zone.compiledWeekSchedule().nextTransition(time);
+            Q_UNUSED(slot)
+            Q_UNUSED(next)
+        }
+        recorder.stop();
+    }
+    recorder.report();
+
+    QBENCHMARK {
+        foreach (const ZoneInfo &zone, zones) {
+            zone.compiledWeekSchedule().activeSlot(CompiledWeekSchedule::secondOfWeek(now));
+        }
+    }
+}
+
+void AirConditioningBenchmark::scheduleValidation_data()
+{
+    QTest::addColumn<int>("slotsPerDay");
+
+    QTest::newRow("4 slots") << 4;
+    QTest::newRow("48 slots") << 48;
+    QTest::newRow("288 slots") << 288;
+}
+
+void AirConditioningBenchmark::scheduleValidation()
+{
+    QFETCH(int, slotsPerDay);
+
+    TemperatureWeekSchedule weekSchedule = createWeekSchedule(slotsPerDay);
+    QVERIFY(weekSchedule.validate().isEmpty());
+
+    QBENCHMARK {
+        weekSchedule.validate();
+    }
+}
+
+void AirConditioningBenchmark::storageLoad_data()
+{
+    QTest::addColumn<bool>("binary");
+    QTest::addColumn<int>("zoneCount");
+
+    QTest::newRow("ini, 100 zones") << false << 100;
+    QTest::newRow("binary, 100 zones") << true << 100;
+    QTest::newRow("ini, 500 zones") << false << 500;
+    QTest::newRow("binary, 500 zones") << true << 500;
+}
+
+void AirConditioningBenchmark::storageLoad()
+{
+    QFETCH(bool, binary);
+    QFETCH(int, zoneCount);
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QHash<QUuid, ZoneInfo> zones = createZones(zoneCount, 8, 4);
+    QString fileName = dir.filePath("zones");
+    if (binary) {
+        QVERIFY(ZoneStorage::saveBinary(fileName, zones.values()));
+    } else {
+        ZoneStorage::saveIni(fileName, zones, QSet<QUuid>(zones.keyBegin(), zones.keyEnd()));
+    }
+    qInfo() << "File size:" << QFileInfo(fileName).size() << "bytes";
+
+    QBENCHMARK {
+        QList<ZoneInfo> loaded;
+        if (binary) {
+            bool ok = false;
+            loaded = ZoneStorage::loadBinary(fileName, &ok);
+            QVERIFY(ok);
+        } else {
+            loaded = ZoneStorage::loadIni(fileName);
+        }
+        QCOMPARE(loaded.count(), zoneCount);
+    }
+}
+
+void AirConditioningBenchmark::storageSave_data()
+{
+    storageLoad_data();
+}
+
+void AirConditioningBenchmark::storageSave()
+{
+    QFETCH(bool, binary);
+    QFETCH(int, zoneCount);
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QHash<QUuid, ZoneInfo> zones = createZones(zoneCount, 8, 4);
+    QSet<QUuid> zoneIds(zones.keyBegin(), zones.keyEnd());
+    QString fileName = dir.filePath("zones");
+
+    QBENCHMARK {
+        if (binary) {
+            QVERIFY(ZoneStorage::saveBinary(fileName, zones.values()));
+        } else {
+            ZoneStorage::saveIni(fileName, zones, zoneIds);
+        }
+    }
+}
+
+void AirConditioningBenchmark::stateChanges_data()
+{
+    QTest::addColumn<int>("zoneCount");
+    QTest::addColumn<int>("sensorsPerZone");
+    QTest::addColumn<int>("eventsPerSecond");
+
+    QTest::newRow("10 zones, 2 sensors, 1 event/s") << 10 << 2 << 1;
+    QTest::newRow("50 zones, 4 sensors, 10 events/s") << 50 << 4 << 10;
+    QTest::newRow("200 zones, 8 sensors, 100 events/s") << 200 << 8 << 100;
+}
+
+void AirConditioningBenchmark::stateChanges()
+{
+    QFETCH(int, zoneCount);
+    QFETCH(int, sensorsPerZone);
+    QFETCH(int, eventsPerSecond);
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    FakeThings *things = new FakeThings();
+    VirtualClock *clock = new VirtualClock(QDateTime(QDate(2026, 1, 5), QTime(0, 0)));
+    AirConditioningManager manager(things, clock, dir.path());
+    // Saving right away puts the save of a user change into the event that made it
+    manager.setSaveInterval(0);
+
+    struct Zone {
+        QUuid id;
+        Thing *windowSensor;
+        QList<Thing *> sensors;
+    };
+    QList<Zone> zones;
+    for (int i = 0; i < zoneCount; i++) {
+        Zone zone;
+        Thing *thermostat = things->createThermostat(QString("Thermostat %1").arg(i));
+        zone.windowSensor = things->createWindowSensor(QString("Window %1").arg(i));
+        QList<ThingId> sensorIds;
+        for (int j = 0; j < sensorsPerZone; j++) {
+            zone.sensors.append(things->createIndoorSensor(QString("Sensor %1.%2").arg(i).arg(j)));
+            sensorIds.append(zone.sensors.last()->id());
+        }
+        QPair<AirConditioningManager::AirConditioningError, ZoneInfo> result = manager.addZone(QString("Zone %1").arg(i), {thermostat->id()}, {}, {zone.windowSensor->id()}, sensorIds, {}, {});
+        QCOMPARE(result.first, AirConditioningManager::AirConditioningErrorNoError);
+        zone.id = result.second.id();
+        QCOMPARE(manager.setZoneWeekSchedules(zone.id, createWeekSchedule(8)), AirConditioningManager::AirConditioningErrorNoError);
+        zones.append(zone);
+    }
+    StateTypeId temperatureStateTypeId = zones.first().sensors.first()->thingClass().stateTypes().findByName("temperature").id();
+    StateTypeId closedStateTypeId = zones.first().windowSensor->thingClass().stateTypes().findByName("closed").id();
+    // Let the initial evaluations and saves happen before measuring
+    clock->advance(0);
+
+    // Events are sensor readings spread over all zones. Every 100th event opens or closes a
+    // window, which makes the thermostat act, and every 500th is a user override, which is saved.
+    int eventCount = 10000;
+    int interval = 1000 / eventsPerSecond;
+    quint64 revision = manager.revision();
+    LatencyRecorder recorder(QTest::currentDataTag(), eventCount);
+    for (int i = 0; i < eventCount; i++) {
+        const Zone &zone = zones.at(i % zoneCount);
+        recorder.start();
+        if (i % 500 == 499) {
+            manager.setZoneSetpointOverride(zone.id, 23, ZoneInfo::SetpointOverrideModeTimed, 60);
+        } else if (i % 100 == 99) {
+            things->setStateValue(zone.windowSensor, closedStateTypeId, !zone.windowSensor->stateValue(closedStateTypeId).toBool());
+        } else {
+            Thing *sensor = zone.sensors.at((i / zoneCount) % sensorsPerZone);
+            things->setStateValue(sensor, temperatureStateTypeId, 19 + (i % 40) * 0.1);
+        }
+        QCoreApplication::processEvents();
+        recorder.stop();
+        // Schedule transitions and override expiries on the way happen outside of the measurement
+        clock->advance(interval);
+    }
+    recorder.report();
+    qInfo() << "Simulated" << clock->now().toString() << "Coalesced evaluations:" << manager.coalescedEvaluations();
+    QVERIFY(manager.revision() > revision);
+}
+
+void AirConditioningBenchmark::simulatedWeek()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    FakeThings *things = new FakeThings();
+    Thing *thermostat = things->createThermostat("Thermostat");
+    // Monday midnight
+    QDateTime start(QDate(2026, 1, 5), QTime(0, 0));
+    VirtualClock *clock = new VirtualClock(start);
+    AirConditioningManager manager(things, clock, dir.path());
+
+    QPair<AirConditioningManager::AirConditioningError, ZoneInfo> result = manager.addZone("Living room", {thermostat->id()}, {}, {}, {}, {}, {});
+    QCOMPARE(result.first, AirConditioningManager::AirConditioningErrorNoError);
+    QUuid zoneId = result.second.id();
+    TemperatureWeekSchedule weekSchedule;
+    for (int day = 0; day < 7; day++) {
+        weekSchedule.append(TemperatureDaySchedule({TemperatureSchedule(QTime(6, 0), QTime(8, 0), 22), TemperatureSchedule(QTime(17, 0), QTime(22, 0), 21)}));
+    }
+    QCOMPARE(manager.setZoneWeekSchedules(zoneId, weekSchedule), AirConditioningManager::AirConditioningErrorNoError);
+    QCOMPARE(manager.setZoneStandbySetpoint(zoneId, 18), AirConditioningManager::AirConditioningErrorNoError);
+    clock->advance(0);
+    QCOMPARE(manager.zone(zoneId).currentSetpoint(), 18.0);
+
+    struct SetpointChange {
+        QDateTime time;
+        double setpoint;
+        bool timeScheduleActive;
+    };
+    QList<SetpointChange> changes;
+    connect(&manager, &AirConditioningManager::zoneChanged, this, [&changes, clock](const ZoneInfo &zone, ZoneInfo::ZoneFields changedFields){
+        if (changedFields.testFlag(ZoneInfo::ZoneFieldCurrentSetpoint)) {
+            changes.append({clock->now(), zone.currentSetpoint(), zone.zoneStatus().testFlag(ZoneInfo::ZoneStatusFlagTimeScheduleActive)});
+        }
+    });
+
+    // On Wednesday at noon, someone asks for 25 degrees for 90 minutes
+    QDateTime overrideStart(start.date().addDays(2), QTime(12, 0));
+    QElapsedTimer timer;
+    timer.start();
+    clock->advanceTo(overrideStart);
+    QCOMPARE(manager.setZoneSetpointOverride(zoneId, 25, ZoneInfo::SetpointOverrideModeTimed, 90), AirConditioningManager::AirConditioningErrorNoError);
+    clock->advanceTo(start.addDays(7));
+    qInfo() << "Simulated a week in" << timer.elapsed() << "ms";
+
+    QList<SetpointChange> expected;
+    for (int day = 0; day < 7; day++) {
+        QDate date = start.date().addDays(day);
+        expected.append({QDateTime(date, QTime(6, 0)), 22, true});
+        expected.append({QDateTime(date, QTime(8, 0)), 18, false});
+        if (day == 2) {
+            expected.append({overrideStart, 25, false});
+            expected.append({overrideStart.addSecs(90 * 60), 18, false});
+        }
+        expected.append({QDateTime(date, QTime(17, 0)), 21, true});
+        expected.append({QDateTime(date, QTime(22, 0)), 18, false});
+    }
+    QCOMPARE(changes.count(), expected.count());
+    for (int i = 0; i < expected.count(); i++) {
+        QCOMPARE(changes.at(i).time, expected.at(i).time);
+        QCOMPARE(changes.at(i).setpoint, expected.at(i).setpoint);
+        QCOMPARE(changes.at(i).timeScheduleActive, expected.at(i).timeScheduleActive);
+    }
+
+    // The thermostat followed along
+    StateTypeId targetTemperatureStateTypeId = thermostat->thingClass().stateTypes().findByName("targetTemperature").id();
+    QCOMPARE(thermostat->stateValue(targetTemperatureStateTypeId).toDouble(), 18.0);
+}
+
+QTEST_GUILESS_MAIN(AirConditioningBenchmark)
+#include "airconditioningbenchmark.moc"
@@ -0,0 +1,47 @@
+QT -= gui
+QT += testlib sql
+
+TEMPLATE = app
+TARGET = airconditioningbenchmark
+
+greaterThan(QT_MAJOR_VERSION, 5) {
+    CONFIG *= c++17
+    QMAKE_CXXFLAGS *= -std=c++17
+} else {
+    CONFIG *= c++11
+    QMAKE_CXXFLAGS *= -std=c++11
+}
+
+CONFIG += link_pkgconfig console testcase
+CONFIG -= app_bundle
+PKGCONFIG += nymea
+
+INCLUDEPATH += $$PWD/..
+
+HEADERS += fakethings.h \
+    ../airconditioningmanager.h \
+    ../clock.h \
+    ../notifications.h \
+    ../sensoraggregate.h \
+    ../temperatureschedule.h \
+    ../thermostat.h \
+    ../thingregistry.h \
+    ../zonehistory.h \
+    ../zoneinfo.h \
+    ../zonestatusthresholds.h \
+    ../zonestorage.h \
+    ../zonetelemetry.h
+
+SOURCES += airconditioningbenchmark.cpp \
+    fakethings.cpp \
+    ../airconditioningmanager.cpp \
+    ../clock.cpp \
+    ../notifications.cpp \
+    ../sensoraggregate.cpp \
+    ../temperatureschedule.cpp \
+    ../thermostat.cpp \
+    ../thingregistry.cpp \
+    ../zonehistory.cpp \
+    ../zoneinfo.cpp \
+    ../zonestorage.cpp \
+    ../zonetelemetry.cpp
@@ -0,0 +1,168 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-experience-plugin-airconditioning.
+*
+* nymea-experience-plugin-airconditioning is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-experience-plugin-airconditioning is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-experience-plugin-airconditioning. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "fakethings.h"
+
+#include <integrations/thingactioninfo.h>
+
+// Only nymea's ThingManagerImplementation may construct things. It is part of nymea itself
+// and not of libnymea, so the benchmark provides it to create its synthetic things.
+namespace nymeaserver {
+class ThingManagerImplementation
+{
+public:
+    static Thing *createThing(const ThingClass &thingClass, const QString &name, QObject *parent)
+    {
+        Thing *thing = new Thing(thingClass.pluginId(), thingClass, ThingId::createThingId(), parent);
+        thing->setName(name);
+        States states;
+        foreach (const StateType &stateType, thingClass.stateTypes()) {
+            states.append(State(stateType.id(), thing->id()));
+        }
+        thing->setStates(states);
+        foreach (const StateType &stateType, thingClass.stateTypes()) {
+            thing->setStateValue(stateType.id(), stateType.defaultValue());
+        }
+        return thing;
+    }
+};
+}
+
+static StateType createStateType(const QString &name, const QVariant &defaultValue)
+{
+    StateType stateType(StateTypeId::createStateTypeId());
+    stateType.setName(name);
+    stateType.setDisplayName(name);
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    stateType.setType(static_cast<QMetaType::Type>(defaultValue.typeId()));
+#else
+    stateType.setType(defaultValue.type());
+#endif
+    stateType.setDefaultValue(defaultValue);
+    return stateType;
+}
+
+// Writable states have an action type with the same id and name, as in nymea
+static ActionType createActionType(const StateType &stateType)
+{
+    ActionType actionType(ActionTypeId(stateType.id()));
+    actionType.setName(stateType.name());
+    actionType.setDisplayName(stateType.displayName());
+    return actionType;
+}
+
+static ThingClass createThingClass(const QString &name, const QStringList &interfaces, const QList<StateType> &stateTypes, const QList<StateType> &writableStateTypes = QList<StateType>())
+{
+    ThingClass thingClass(PluginId::createPluginId(), VendorId::createVendorId(), ThingClassId::createThingClassId());
+    thingClass.setName(name);
+    thingClass.setDisplayName(name);
+    thingClass.setInterfaces(interfaces);
+    StateTypes allStateTypes;
+    ActionTypes actionTypes;
+    foreach (const StateType &stateType, stateTypes) {
+        allStateTypes.append(stateType);
+    }
+    foreach (const StateType &stateType, writableStateTypes) {
+        allStateTypes.append(stateType);
+        actionTypes.append(createActionType(stateType));
+    }
+    thingClass.setStateTypes(allStateTypes);
+    thingClass.setActionTypes(actionTypes);
+    return thingClass;
+}
+
+FakeThings::FakeThings(QObject *parent):
+    ThingRegistry(parent)
+{
+    StateType targetTemperature = createStateType("targetTemperature", 21.0);
+    targetTemperature.setMinValue(5.0);
+    targetTemperature.setMaxValue(30.0);
+    // No windowOpen action, so an open window turns the thermostat off
+    m_thermostatClass = createThingClass("fakeThermostat", {"thermostat", "temperaturesensor"},
+                                         {createStateType("temperature", 21.0)},
+                                         {targetTemperature, createStateType("power", true)});
+    m_windowSensorClass = createThingClass("fakeWindowSensor", {"closablesensor"}, {createStateType("closed", true)});
+    m_indoorSensorClass = createThingClass("fakeIndoorSensor", {"temperaturesensor", "humiditysensor"},
+                                           {createStateType("temperature", 21.0), createStateType("humidity", 45.0)});
+}
+
+Thing *FakeThings::createThermostat(const QString &name)
+{
+    return createThing(m_thermostatClass, name);
+}
+
+Thing *FakeThings::createWindowSensor(const QString &name)
+{
+    return createThing(m_windowSensorClass, name);
+}
+
+Thing *FakeThings::createIndoorSensor(const QString &name)
+{
+    return createThing(m_indoorSensorClass, name);
+}
+
+void FakeThings::setStateValue(Thing *thing, const StateTypeId &stateTypeId, const QVariant &value)
+{
+    thing->setStateValue(stateTypeId, value);
+    emit thingStateChanged(thing, stateTypeId, value, QVariant(), QVariant());
+}
+
+Things FakeThings::configuredThings() const
+{
+    Things things;
+    foreach (Thing *thing, m_things) {
+        things.append(thing);
+    }
+    return things;
+}
+
+Thing *FakeThings::findConfiguredThing(const ThingId &thingId) const
+{
+    return m_things.value(thingId);
+}
+
+ThingActionInfo *FakeThings::executeAction(const Action &action)
+{
+    Thing *thing = m_things.value(action.thingId());
+    ThingActionInfo *info = new ThingActionInfo(thing, action, nullptr);
+    // Devices answer asynchronously, the caller connects to finished() after this returns
+    QMetaObject::invokeMethod(this, [this, thing, info, action](){
+        if (!thing) {
+            info->finish(Thing::ThingErrorThingNotFound);
+            return;
+        }
+        setStateValue(thing, StateTypeId(action.actionTypeId()), action.paramValue(action.actionTypeId()));
+        info->finish(Thing::ThingErrorNoError);
+        emit actionExecuted(action, Thing::ThingErrorNoError);
+    }, Qt::QueuedConnection);
+    return info;
+}
+
+Thing *FakeThings::createThing(const ThingClass &thingClass, const QString &name)
+{
+    Thing *thing = nymeaserver::ThingManagerImplementation::createThing(thingClass, name, this);
+    m_things.insert(thing->id(), thing);
+    emit thingAdded(thing);
+    return thing;
+}
@@ -0,0 +1,60 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-experience-plugin-airconditioning.
+*
+* nymea-experience-plugin-airconditioning is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-experience-plugin-airconditioning is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-experience-plugin-airconditioning. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef FAKETHINGS_H
+#define FAKETHINGS_H
+
+#include <QHash>
+
+#include "thingregistry.h"
+
+// Synthetic thermostats, window sensors and indoor sensors for driving the manager without
+// a running nymea. Actions succeed asynchronously and update the corresponding state.
+class FakeThings : public ThingRegistry
+{
+    Q_OBJECT
+public:
+    explicit FakeThings(QObject *parent = nullptr);
+
+    Thing *createThermostat(const QString &name);
+    Thing *createWindowSensor(const QString &name);
+    Thing *createIndoorSensor(const QString &name);
+
+    // Updates the state and emits thingStateChanged(), like nymea does for device events
+    void setStateValue(Thing *thing, const StateTypeId &stateTypeId, const QVariant &value);
+
+    Things configuredThings() const override;
+    Thing *findConfiguredThing(const ThingId &thingId) const override;
+    ThingActionInfo *executeAction(const Action &action) override;
+
+private:
+    Thing *createThing(const ThingClass &thingClass, const QString &name);
+
+    ThingClass m_thermostatClass;
+    ThingClass m_windowSensorClass;
+    ThingClass m_indoorSensorClass;
+    QHash<ThingId, Thing *> m_things;
+};
+
+#endif // FAKETHINGS_H
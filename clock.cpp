@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-experience-plugin-airconditioning.
+*
+* nymea-experience-plugin-airconditioning is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-experience-plugin-airconditioning is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-experience-plugin-airconditioning. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "clock.h"
+
+#include <QTimer>
+#include <QCoreApplication>
+
+#include <limits>
+
+Clock::Clock(QObject *parent):
+    QObject(parent)
+{
+    m_timer = new QTimer(this);
+    m_timer->setSingleShot(true);
+    m_timer->setTimerType(Qt::PreciseTimer);
+    connect(m_timer, &QTimer::timeout, this, &Clock::wakeup);
+}
+
+QDateTime Clock::now() const
+{
+    return QDateTime::currentDateTime();
+}
+
+void Clock::requestWakeup(const QDateTime &time)
+{
+    qint64 interval = qBound<qint64>(0, now().msecsTo(time), std::numeric_limits<int>::max());
+    m_timer->start(static_cast<int>(interval));
+}
+
+VirtualClock::VirtualClock(const QDateTime &startTime, QObject *parent):
+    Clock(parent),
+    m_now(startTime)
+{
+
+}
+
+QDateTime VirtualClock::now() const
+{
+    return m_now;
+}
+
+void VirtualClock::requestWakeup(const QDateTime &time)
+{
+    m_wakeupTime = qMax(time, m_now);
+}
+
+void VirtualClock::advanceTo(const QDateTime &time)
+{
+    // Anything already queued belongs to the current time, not to the next wakeup
+    QCoreApplication::processEvents();
+
+    while (m_wakeupTime.isValid() && m_wakeupTime <= time) {
+        m_now = m_wakeupTime;
+        m_wakeupTime = QDateTime();
+        emit wakeup();
+        // The evaluations triggered by this wakeup run before time moves on. They usually
+        // request the next wakeup, which may be earlier than the one seen before.
+        QCoreApplication::processEvents();
+    }
+    m_now = qMax(time, m_now);
+}
+
+void VirtualClock::advance(qint64 msecs)
+{
+    advanceTo(m_now.addMSecs(msecs));
+}
@@ -0,0 +1,74 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-experience-plugin-airconditioning.
+*
+* nymea-experience-plugin-airconditioning is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-experience-plugin-airconditioning is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-experience-plugin-airconditioning. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <QObject>
+#include <QDateTime>
+
+class QTimer;
+
+// The source of time for the air conditioning experience. Everything that depends on the
+// current time or needs to wake up at a certain point in time goes through this, so that
+// a VirtualClock can be used to simulate days of schedules within seconds.
+class Clock : public QObject
+{
+    Q_OBJECT
+public:
+    explicit Clock(QObject *parent = nullptr);
+
+    virtual QDateTime now() const;
+
+    // Emits wakeup() once at the given time. Replaces any previously requested wakeup.
+    virtual void requestWakeup(const QDateTime &time);
+
+signals:
+    void wakeup();
+
+private:
+    QTimer *m_timer = nullptr;
+};
+
+class VirtualClock : public Clock
+{
+    Q_OBJECT
+public:
+    explicit VirtualClock(const QDateTime &startTime, QObject *parent = nullptr);
+
+    QDateTime now() const override;
+    void requestWakeup(const QDateTime &time) override;
+
+    // Moves time forward, emitting wakeup() at every requested wakeup time on the way, in
+    // order. Pending events are processed before time moves and after each wakeup so that
+    // coalesced zone evaluations (with a coalescing interval of 0) run at the simulated time.
+    void advanceTo(const QDateTime &time);
+    void advance(qint64 msecs);
+
+private:
+    QDateTime m_now;
+    QDateTime m_wakeupTime;
+};
+
+#endif // CLOCK_H
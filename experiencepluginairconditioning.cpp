@@ -26,6 +26,7 @@
 
 #include "airconditioningmanager.h"
 #include "airconditioningjsonhandler.h"
+#include "airconditioningdeltajsonhandler.h"
 
 #include <jsonrpc/jsonrpcserver.h>
 #include <loggingcategories.h>
@@ -43,5 +44,6 @@ void ExperiencePluginAirConditioning::init()
 
     m_manager = new AirConditioningManager(thingManager(), this);
     jsonRpcServer()->registerExperienceHandler(new AirConditioningJsonHandler(m_manager, this), 1, 1);
+    jsonRpcServer()->registerExperienceHandler(new AirConditioningDeltaJsonHandler(m_manager, this), 1, 1);
 
 }
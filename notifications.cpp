@@ -23,33 +23,24 @@
 * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include "notifications.h"
+#include "zonestatusthresholds.h"
 
 #include <QUrlQuery>
 
-Notifications::Notifications(ThingManager *thingManager, Thing *thing, QObject *parent)
+static const int rearmTimeout = 30 * 60;
+
+Notifications::Notifications(ThingRegistry *things, Thing *thing, Clock *clock, QObject *parent)
     : QObject{parent},
-      m_thingManager(thingManager),
-      m_thing(thing)
+      m_things(things),
+      m_thing(thing),
+      m_clock(clock)
 {
-    m_clearHumidityTimer.setInterval(30*60*1000);
-    m_clearHumidityTimer.setSingleShot(true);
-    connect(&m_clearHumidityTimer, &QTimer::timeout, this, [this](){
-        m_humidityWarningShown = false;
-    });
-
-    m_clearBadAirTimer.setInterval(30*60*1000);
-    m_clearBadAirTimer.setSingleShot(true);
-    connect(&m_clearBadAirTimer, &QTimer::timeout, this, [this](){
-        m_badAirWarningShown = false;
-    });
+    updateTypes();
 }
 
 void Notifications::update(const ZoneInfo &zone)
 {
-    bool supportsUpdate = m_thing->thingClassId() == ThingClassId("f0dd4c03-0aca-42cc-8f34-9902457b05de")
-            && m_thing->paramValue("service").toString() == "FB-GCM"
-            // Updating is only supported with versions that have the notificationId param
-            && !m_thing->thingClass().actionTypes().findByName("notify").paramTypes().findByName("notificationId").id().isNull();
+    bool supportsUpdate = m_supportsUpdate;
 
     QString notificationId = "humidityalert-" + zone.id().toString();
     QString title = "High humidity alert";
@@ -74,7 +65,8 @@ void Notifications::update(const ZoneInfo &zone)
             if (actionInfo->status() == Thing::ThingErrorNoError) {
                 m_humidityWarningShown = zone.zoneStatus().testFlag(ZoneInfo::ZoneStatusFlagHighHumidity);
                 m_lastHumidityValue = zone.humidity();
-                m_clearHumidityTimer.start();
+                m_humidityRearmTime = m_humidityWarningShown ? m_clock->now().addSecs(rearmTimeout) : QDateTime();
+                emit nextRearmChanged();
             }
         });
     }
@@ -83,13 +75,18 @@ void Notifications::update(const ZoneInfo &zone)
     notificationId = "airalert-" + zone.id().toString();
     title = "Bad air alert";
     text = QString("Bad air in zone %1: %2").arg(zone.name());
+    // The flag stays set down to the exit thresholds
     QStringList airValues;
-    if (zone.voc() >= 660) {
+    if (zone.voc() >= badAirVocExit) {
         airValues.append(QString("%1 ppm").arg(zone.voc()));
     }
-    if (zone.pm25() >= 25) {
+    if (zone.pm25() >= badAirPm25Exit) {
         airValues.append(QString("%1 µg/m³").arg(zone.pm25()));
     }
+    if (airValues.isEmpty()) {
+        // Clearing, but not for long enough yet
+        airValues << QString("%1 ppm").arg(zone.voc()) << QString("%1 µg/m³").arg(zone.pm25());
+    }
     text = text.arg(airValues.join(","));
     actionInfo = nullptr;
     if (zone.zoneStatus().testFlag(ZoneInfo::ZoneStatusFlagBadAir)) {
@@ -111,36 +108,77 @@ void Notifications::update(const ZoneInfo &zone)
             if (actionInfo->status() == Thing::ThingErrorNoError) {
                 m_badAirWarningShown = zone.zoneStatus().testFlag(ZoneInfo::ZoneStatusFlagBadAir);
                 m_lastBadAirValue = zone.voc();
-                m_clearHumidityTimer.start();
+                m_badAirRearmTime = m_badAirWarningShown ? m_clock->now().addSecs(rearmTimeout) : QDateTime();
+                emit nextRearmChanged();
             }
         });
     }
 }
 
+void Notifications::updateTypes()
+{
+    ActionType notifyActionType = m_thing->thingClass().actionTypes().findByName("notify");
+    m_notifyActionTypeId = notifyActionType.id();
+    m_titleParamTypeId = notifyActionType.paramTypes().findByName("title").id();
+    m_bodyParamTypeId = notifyActionType.paramTypes().findByName("body").id();
+    m_dataParamTypeId = notifyActionType.paramTypes().findByName("data").id();
+    m_notificationIdParamTypeId = notifyActionType.paramTypes().findByName("notificationId").id();
+    m_soundParamTypeId = notifyActionType.paramTypes().findByName("sound").id();
+    m_removeParamTypeId = notifyActionType.paramTypes().findByName("remove").id();
+
+    m_isPushNotification = m_thing->thingClassId() == ThingClassId("f0dd4c03-0aca-42cc-8f34-9902457b05de");
+    m_supportsUpdate = m_isPushNotification
+            && m_thing->paramValue("service").toString() == "FB-GCM"
+            // Updating is only supported with versions that have the notificationId param
+            && !m_notificationIdParamTypeId.isNull();
+}
+
+QDateTime Notifications::nextRearm() const
+{
+    if (!m_humidityRearmTime.isValid()) {
+        return m_badAirRearmTime;
+    }
+    if (!m_badAirRearmTime.isValid()) {
+        return m_humidityRearmTime;
+    }
+    return qMin(m_humidityRearmTime, m_badAirRearmTime);
+}
+
+void Notifications::rearm(const QDateTime &now)
+{
+    if (m_humidityRearmTime.isValid() && m_humidityRearmTime <= now) {
+        m_humidityWarningShown = false;
+        m_humidityRearmTime = QDateTime();
+    }
+    if (m_badAirRearmTime.isValid() && m_badAirRearmTime <= now) {
+        m_badAirWarningShown = false;
+        m_badAirRearmTime = QDateTime();
+    }
+}
+
 ThingActionInfo* Notifications::updateNotification(const QString &id, const QString &title, const QString &text, bool sound, bool remove)
 {
-    ActionType actionType = m_thing->thingClass().actionTypes().findByName("notify");
-    Action action(actionType.id(), m_thing->id(), Action::TriggeredByRule);
+    Action action(m_notifyActionTypeId, m_thing->id(), Action::TriggeredByRule);
 
     ParamList params = ParamList{
-         Param(actionType.paramTypes().findByName("title").id(), title),
-         Param(actionType.paramTypes().findByName("body").id(), text),
+         Param(m_titleParamTypeId, title),
+         Param(m_bodyParamTypeId, text),
      };
 
-    if (m_thing->thingClassId() == ThingClassId("f0dd4c03-0aca-42cc-8f34-9902457b05de")) {
+    if (m_isPushNotification) {
         QUrlQuery data;
         data.addQueryItem("open", "airconditioning");
-        params.append(Param(actionType.paramTypes().findByName("data").id(), data.toString()));
+        params.append(Param(m_dataParamTypeId, data.toString()));
 
         // For backwards compatibility, only add those if the plugin already has them
-        if (!m_thing->thingClass().actionTypes().findByName("notify").paramTypes().findByName("notificationId").id().isNull()) {
-            params.append(Param(actionType.paramTypes().findByName("notificationId").id(), id));
-            params.append(Param(actionType.paramTypes().findByName("sound").id(), sound));
-            params.append(Param(actionType.paramTypes().findByName("remove").id(), remove));
+        if (!m_notificationIdParamTypeId.isNull()) {
+            params.append(Param(m_notificationIdParamTypeId, id));
+            params.append(Param(m_soundParamTypeId, sound));
+            params.append(Param(m_removeParamTypeId, remove));
         }
     }
     action.setParams(params);
 
-    ThingActionInfo *info = m_thingManager->executeAction(action);
+    ThingActionInfo *info = m_things->executeAction(action);
     return info;
 }
@@ -26,28 +26,50 @@
 #define NOTIFICATIONS_H
 
 #include <QObject>
-#include <QTimer>
+#include <QDateTime>
 
 #include <integrations/thing.h>
-#include <integrations/thingmanager.h>
 
 #include "zoneinfo.h"
+#include "clock.h"
+#include "thingregistry.h"
 
 
 class Notifications : public QObject
 {
     Q_OBJECT
 public:
-    explicit Notifications(ThingManager *thingManager, Thing *thing, QObject *parent = nullptr);
+    explicit Notifications(ThingRegistry *things, Thing *thing, Clock *clock, QObject *parent = nullptr);
 
     void update(const ZoneInfo &zone);
+
+    // Resolves the action and param types in use, needs to be called when the thing or its class changes
+    void updateTypes();
+
+    // The next point in time when a shown warning will be considered gone
+    QDateTime nextRearm() const;
+    void rearm(const QDateTime &now);
+
 signals:
+    void nextRearmChanged();
 
 private:
     ThingActionInfo *updateNotification(const QString &id, const QString &title, const QString &text, bool sound, bool remove);
 private:
-    ThingManager *m_thingManager = nullptr;
+    ThingRegistry *m_things = nullptr;
     Thing *m_thing = nullptr;
+    Clock *m_clock = nullptr;
+
+    ActionTypeId m_notifyActionTypeId;
+    ParamTypeId m_titleParamTypeId;
+    ParamTypeId m_bodyParamTypeId;
+    ParamTypeId m_dataParamTypeId;
+    ParamTypeId m_notificationIdParamTypeId;
+    ParamTypeId m_soundParamTypeId;
+    ParamTypeId m_removeParamTypeId;
+    // nymea:cloud push notifications support deep links, newer versions also updating and removing notifications
+    bool m_isPushNotification = false;
+    bool m_supportsUpdate = false;
 
     ZoneInfo::ZoneStatus m_zoneStatus;
 
@@ -57,8 +79,8 @@ private:
     uint m_lastBadAirValue = 0;
 
     // For devices that don't support updates/removals, we'll assume after some time that it's gone and we may need to show again
-    QTimer m_clearHumidityTimer;
-    QTimer m_clearBadAirTimer;
+    QDateTime m_humidityRearmTime;
+    QDateTime m_badAirRearmTime;
 };
 
 
@@ -21,20 +21,35 @@ QT -= gui
 QT += network sql
 
 HEADERS += experiencepluginairconditioning.h \
+    airconditioningdeltajsonhandler.h \
     airconditioningjsonhandler.h \
     airconditioningmanager.h \
+    clock.h \
     notifications.h \
+    sensoraggregate.h \
     temperatureschedule.h \
     thermostat.h \
-    zoneinfo.h
+    thingregistry.h \
+    zonehistory.h \
+    zoneinfo.h \
+    zonestatusthresholds.h \
+    zonestorage.h \
+    zonetelemetry.h
 
 SOURCES += experiencepluginairconditioning.cpp \
+    airconditioningdeltajsonhandler.cpp \
     airconditioningjsonhandler.cpp \
     airconditioningmanager.cpp \
+    clock.cpp \
     notifications.cpp \
+    sensoraggregate.cpp \
     temperatureschedule.cpp \
     thermostat.cpp \
-    zoneinfo.cpp
+    thingregistry.cpp \
+    zonehistory.cpp \
+    zoneinfo.cpp \
+    zonestorage.cpp \
+    zonetelemetry.cpp
 
 
 target.path = $$[QT_INSTALL_LIBS]/nymea/experiences/
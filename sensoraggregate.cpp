@@ -0,0 +1,183 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-experience-plugin-airconditioning.
+*
+* nymea-experience-plugin-airconditioning is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-experience-plugin-airconditioning is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-experience-plugin-airconditioning. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "sensoraggregate.h"
+
+void SensorAggregate::setMode(ZoneInfo::AggregationMode mode)
+{
+    m_mode = mode;
+}
+
+void SensorAggregate::setFilter(ZoneInfo::SmoothingFilter filter, int window)
+{
+    m_filter = filter;
+    m_window = qBound(1, window, static_cast<int>(maxWindow));
+    clear();
+}
+
+void SensorAggregate::setValue(const QUuid &sensorId, double value)
+{
+    if (m_filter != ZoneInfo::SmoothingFilterNone) {
+        value = smooth(&m_samples[sensorId], value);
+    }
+
+    QHash<QUuid, double>::iterator it = m_values.find(sensorId);
+    if (it != m_values.end()) {
+        if (it.value() == value) {
+            return;
+        }
+        double oldValue = it.value();
+        QMap<double, int>::iterator sortedIt = m_sortedValues.find(oldValue);
+        if (--sortedIt.value() == 0) {
+            m_sortedValues.erase(sortedIt);
+        }
+        m_sum -= oldValue;
+        it.value() = value;
+    } else {
+        m_values.insert(sensorId, value);
+    }
+    m_sortedValues[value]++;
+    m_sum += value;
+}
+
+void SensorAggregate::removeValue(const QUuid &sensorId)
+{
+    m_samples.remove(sensorId);
+    QHash<QUuid, double>::iterator it = m_values.find(sensorId);
+    if (it == m_values.end()) {
+        return;
+    }
+    double value = it.value();
+    m_values.erase(it);
+    QMap<double, int>::iterator sortedIt = m_sortedValues.find(value);
+    if (--sortedIt.value() == 0) {
+        m_sortedValues.erase(sortedIt);
+    }
+    m_sum -= value;
+    if (m_values.isEmpty()) {
+        // Don't carry rounding errors over
+        m_sum = 0;
+    }
+}
+
+void SensorAggregate::clear()
+{
+    m_samples.clear();
+    m_values.clear();
+    m_sortedValues.clear();
+    m_sum = 0;
+}
+
+bool SensorAggregate::isEmpty() const
+{
+    return m_values.isEmpty();
+}
+
+double SensorAggregate::value() const
+{
+    switch (m_mode) {
+    case ZoneInfo::AggregationModeMax:
+        return max();
+    case ZoneInfo::AggregationModeMean:
+        return mean();
+    case ZoneInfo::AggregationModeMedian:
+        return median();
+    case ZoneInfo::AggregationModeTrimmedMean:
+        return trimmedMean();
+    }
+    return max();
+}
+
+double SensorAggregate::max() const
+{
+    if (m_sortedValues.isEmpty()) {
+        return 0;
+    }
+    return m_sortedValues.lastKey();
+}
+
+double SensorAggregate::mean() const
+{
+    if (m_values.isEmpty()) {
+        return 0;
+    }
+    return m_sum / m_values.count();
+}
+
+double SensorAggregate::median() const
+{
+    int count = m_values.count();
+    if (count == 0) {
+        return 0;
+    }
+    return rangeMean((count - 1) / 2, count / 2);
+}
+
+double SensorAggregate::trimmedMean() const
+{
+    int count = m_values.count();
+    if (count == 0) {
+        return 0;
+    }
+    int trim = count / 4;
+    return rangeMean(trim, count - 1 - trim);
+}
+
+double SensorAggregate::smooth(Samples *samples, double value) const
+{
+    if (samples->count == 0) {
+        samples->smoothed = value;
+    } else if (m_filter == ZoneInfo::SmoothingFilterExponential) {
+        // Same weight as a sliding window of that many samples would give to the latest one
+        double alpha = 2.0 / (m_window + 1);
+        samples->smoothed += alpha * (value - samples->smoothed);
+    }
+
+    samples->values[samples->next] = value;
+    samples->next = (samples->next + 1) % m_window;
+    samples->count = qMin(samples->count + 1, m_window);
+
+    if (m_filter == ZoneInfo::SmoothingFilterSlidingWindow) {
+        double sum = 0;
+        for (int i = 0; i < samples->count; i++) {
+            sum += samples->values[i];
+        }
+        samples->smoothed = sum / samples->count;
+    }
+    return samples->smoothed;
+}
+
+double SensorAggregate::rangeMean(int first, int last) const
+{
+    double sum = 0;
+    int index = 0;
+    for (QMap<double, int>::const_iterator it = m_sortedValues.constBegin(); it != m_sortedValues.constEnd() && index <= last; ++it) {
+        for (int i = 0; i < it.value() && index <= last; i++, index++) {
+            if (index >= first) {
+                sum += it.key();
+            }
+        }
+    }
+    return sum / (last - first + 1);
+}
@@ -0,0 +1,86 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-experience-plugin-airconditioning.
+*
+* nymea-experience-plugin-airconditioning is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-experience-plugin-airconditioning is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-experience-plugin-airconditioning. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef SENSORAGGREGATE_H
+#define SENSORAGGREGATE_H
+
+#include <QHash>
+#include <QMap>
+#include <QUuid>
+
+#include "zoneinfo.h"
+
+// Keeps the latest reading of each sensor contributing to a zone quantity, e.g. the zone temperature.
+// Each sensor's readings can be smoothed over a fixed number of samples before they're aggregated.
+// Aggregated values are kept ordered, so updating a single sensor and querying max or mean is O(log n).
+class SensorAggregate
+{
+public:
+    static const int maxWindow = 16;
+
+    void setMode(ZoneInfo::AggregationMode mode);
+
+    // Drops all readings
+    void setFilter(ZoneInfo::SmoothingFilter filter, int window);
+
+    void setValue(const QUuid &sensorId, double value);
+    void removeValue(const QUuid &sensorId);
+
+    bool isEmpty() const;
+
+    // The aggregate according to the mode, 0 if there are no readings
+    double value() const;
+
+private:
+    void clear();
+
+    double max() const;
+    double mean() const;
+    double median() const;
+    // Mean without the lowest and highest quarter of readings
+    double trimmedMean() const;
+
+    // Ring buffer of the last readings of a sensor
+    struct Samples {
+        double values[maxWindow];
+        int count = 0;
+        int next = 0;
+        double smoothed = 0;
+    };
+    double smooth(Samples *samples, double value) const;
+    // Mean of the sorted values from index first to last (inclusive)
+    double rangeMean(int first, int last) const;
+
+    ZoneInfo::AggregationMode m_mode = ZoneInfo::AggregationModeMax;
+    ZoneInfo::SmoothingFilter m_filter = ZoneInfo::SmoothingFilterNone;
+    int m_window = 1;
+
+    QHash<QUuid, Samples> m_samples;
+    QHash<QUuid, double> m_values;
+    // Value -> number of sensors reporting it
+    QMap<double, int> m_sortedValues;
+    double m_sum = 0;
+};
+
+#endif // SENSORAGGREGATE_H
@@ -24,6 +24,8 @@
 
 #include "temperatureschedule.h"
 
+#include <algorithm>
+
 TemperatureSchedule::TemperatureSchedule()
 {
 
@@ -83,6 +85,44 @@ void TemperatureDaySchedule::put(const QVariant &variant)
     append(variant.value<TemperatureSchedule>());
 }
 
+ScheduleConflict::ScheduleConflict()
+{
+
+}
+
+ScheduleConflict::ScheduleConflict(int day, int index, int otherIndex):
+    m_day(day),
+    m_index(index),
+    m_otherIndex(otherIndex)
+{
+
+}
+
+int ScheduleConflict::day() const
+{
+    return m_day;
+}
+
+int ScheduleConflict::index() const
+{
+    return m_index;
+}
+
+int ScheduleConflict::otherIndex() const
+{
+    return m_otherIndex;
+}
+
+QVariant ScheduleConflicts::get(int index) const
+{
+    return QVariant::fromValue(at(index));
+}
+
+void ScheduleConflicts::put(const QVariant &variant)
+{
+    append(variant.value<ScheduleConflict>());
+}
+
 TemperatureWeekSchedule TemperatureWeekSchedule::create() {
     TemperatureWeekSchedule ret;
     for (int day = 0; day < 7; day++) {
@@ -91,6 +131,40 @@ TemperatureWeekSchedule TemperatureWeekSchedule::create() {
     return ret;
 }
 
+ScheduleConflicts TemperatureWeekSchedule::validate() const
+{
+    ScheduleConflicts conflicts;
+    for (int day = 0; day < count(); day++) {
+        const TemperatureDaySchedule &daySchedule = at(day);
+
+        QVector<int> sorted;
+        sorted.reserve(daySchedule.count());
+        for (int i = 0; i < daySchedule.count(); i++) {
+            if (daySchedule.at(i).startTime() >= daySchedule.at(i).endTime()) {
+                conflicts.append(ScheduleConflict(day, i));
+                continue;
+            }
+            sorted.append(i);
+        }
+        std::sort(sorted.begin(), sorted.end(), [&daySchedule](int a, int b) {
+            return daySchedule.at(a).startTime() < daySchedule.at(b).startTime();
+        });
+
+        // Sorted by start time, an entry overlaps with all following ones that start before it ends
+        for (int i = 0; i < sorted.count(); i++) {
+            const TemperatureSchedule &schedule = daySchedule.at(sorted.at(i));
+            for (int j = i + 1; j < sorted.count(); j++) {
+                const TemperatureSchedule &other = daySchedule.at(sorted.at(j));
+                if (other.startTime() >= schedule.endTime()) {
+                    break;
+                }
+                conflicts.append(ScheduleConflict(day, qMin(sorted.at(i), sorted.at(j)), qMax(sorted.at(i), sorted.at(j))));
+            }
+        }
+    }
+    return conflicts;
+}
+
 QVariant TemperatureWeekSchedule::get(int index) const
 {
     return QVariant::fromValue(at(index));
@@ -101,6 +175,98 @@ void TemperatureWeekSchedule::put(const QVariant &variant)
     append(variant.value<TemperatureDaySchedule>());
 }
 
+CompiledWeekSchedule::CompiledWeekSchedule(const TemperatureWeekSchedule &weekSchedule)
+{
+    for (int day = 0; day < qMin(weekSchedule.count(), 7); day++) {
+        const TemperatureDaySchedule &daySchedule = weekSchedule.at(day);
+        for (int i = 0; i < daySchedule.count(); i++) {
+            const TemperatureSchedule &schedule = daySchedule.at(i);
+            if (!schedule.startTime().isValid() || !schedule.endTime().isValid() || schedule.startTime() >= schedule.endTime()) {
+                continue;
+            }
+            Slot slot;
+            slot.start = day * 24 * 60 * 60 + schedule.startTime().msecsSinceStartOfDay() / 1000;
+            slot.end = day * 24 * 60 * 60 + schedule.endTime().msecsSinceStartOfDay() / 1000;
+            slot.temperature = schedule.temperature();
+            m_slots.append(slot);
+            m_transitions.append(slot.start);
+            m_transitions.append(slot.end);
+        }
+    }
+
+    std::sort(m_slots.begin(), m_slots.end(), [](const Slot &a, const Slot &b) {
+        return a.start < b.start;
+    });
+    std::sort(m_transitions.begin(), m_transitions.end());
+    m_transitions.erase(std::unique(m_transitions.begin(), m_transitions.end()), m_transitions.end());
+}
+
+int CompiledWeekSchedule::secondOfWeek(const QDateTime &dateTime)
+{
+    return (dateTime.date().dayOfWeek() - 1) * 24 * 60 * 60 + dateTime.time().msecsSinceStartOfDay() / 1000;
+}
+
+bool CompiledWeekSchedule::isEmpty() const
+{
+    return m_slots.isEmpty();
+}
+
+const CompiledWeekSchedule::Slot *CompiledWeekSchedule::activeSlot(int secondOfWeek) const
+{
+    // The last slot starting at or before secondOfWeek is the only candidate as slots don't overlap
+    QVector<Slot>::const_iterator it = std::upper_bound(m_slots.constBegin(), m_slots.constEnd(), secondOfWeek, [](int second, const Slot &slot) {
+        return second < slot.start;
+    });
+    if (it == m_slots.constBegin()) {
+        return nullptr;
+    }
+    --it;
+    if (secondOfWeek < it->end) {
+        return &(*it);
+    }
+    return nullptr;
+}
+
+QDateTime CompiledWeekSchedule::nextTransition(const QDateTime &from) const
+{
+    if (m_transitions.isEmpty()) {
+        return QDateTime();
+    }
+    int second = secondOfWeek(from);
+    QVector<int>::const_iterator it = std::upper_bound(m_transitions.constBegin(), m_transitions.constEnd(), second);
+    int next = it != m_transitions.constEnd() ? *it : m_transitions.first() + secondsPerWeek;
+    QDate weekStart = from.date().addDays(1 - from.date().dayOfWeek());
+    return toDateTime(weekStart, next);
+}
+
+QList<CompiledWeekSchedule::Transition> CompiledWeekSchedule::upcomingTransitions(const QDateTime &from, int count) const
+{
+    QList<Transition> ret;
+    QDateTime time = from;
+    while (ret.count() < count) {
+        time = nextTransition(time);
+        if (!time.isValid()) {
+            break;
+        }
+        Transition transition;
+        transition.time = time;
+        const Slot *slot = activeSlot(secondOfWeek(time));
+        if (slot) {
+            transition.scheduleActive = true;
+            transition.temperature = slot->temperature;
+        }
+        ret.append(transition);
+    }
+    return ret;
+}
+
+QDateTime CompiledWeekSchedule::toDateTime(const QDate &weekStart, int secondOfWeek)
+{
+    QDate date = weekStart.addDays(secondOfWeek / (24 * 60 * 60));
+    QTime time = QTime::fromMSecsSinceStartOfDay((secondOfWeek % (24 * 60 * 60)) * 1000);
+    return QDateTime(date, time);
+}
+
 QDebug operator<<(QDebug dbg, const TemperatureSchedule &schedule)
 {
     QDebugStateSaver saver(dbg);
@@ -131,3 +297,15 @@ QDebug operator<<(QDebug dbg, const TemperatureWeekSchedule &weekSchedule)
     return dbg;
 }
 
+QDebug operator<<(QDebug dbg, const ScheduleConflict &conflict)
+{
+    QDebugStateSaver saver(dbg);
+    QStringList days = { "Mo", "Tu", "We", "Th", "Fr", "Sa", "Su" };
+    dbg.nospace().noquote() << days.value(conflict.day()) << " #" << conflict.index();
+    if (conflict.otherIndex() >= 0) {
+        dbg.nospace().noquote() << " overlaps with #" << conflict.otherIndex();
+    } else {
+        dbg.nospace().noquote() << " ends before it starts";
+    }
+    return dbg;
+}
@@ -26,8 +26,10 @@
 #define TEMPERATURESCHEDULE_H
 
 #include <QObject>
+#include <QDateTime>
 #include <QTime>
 #include <QVariant>
+#include <QVector>
 #include <QDebug>
 
 class TemperatureSchedule
@@ -71,6 +73,42 @@ public:
 Q_DECLARE_METATYPE(QList<TemperatureSchedule>)
 Q_DECLARE_METATYPE(TemperatureDaySchedule)
 
+// Describes an invalid entry in a week schedule. If otherIndex is -1, the entry at index
+// ends before it starts, otherwise the entries at index and otherIndex overlap.
+class ScheduleConflict
+{
+    Q_GADGET
+    Q_PROPERTY(int day READ day)
+    Q_PROPERTY(int index READ index)
+    Q_PROPERTY(int otherIndex READ otherIndex)
+
+public:
+    ScheduleConflict();
+    ScheduleConflict(int day, int index, int otherIndex = -1);
+
+    int day() const;
+    int index() const;
+    int otherIndex() const;
+
+private:
+    int m_day = 0;
+    int m_index = 0;
+    int m_otherIndex = -1;
+};
+Q_DECLARE_METATYPE(ScheduleConflict)
+
+class ScheduleConflicts: public QList<ScheduleConflict>
+{
+    Q_GADGET
+    Q_PROPERTY(int count READ count)
+public:
+    ScheduleConflicts() = default;
+    Q_INVOKABLE QVariant get(int index) const;
+    Q_INVOKABLE void put(const QVariant &variant);
+};
+Q_DECLARE_METATYPE(QList<ScheduleConflict>)
+Q_DECLARE_METATYPE(ScheduleConflicts)
+
 class TemperatureWeekSchedule: public QList<TemperatureDaySchedule>
 {
     Q_GADGET
@@ -78,12 +116,59 @@ class TemperatureWeekSchedule: public QList<TemperatureDaySchedule>
 public:
     static TemperatureWeekSchedule create();
     TemperatureWeekSchedule() = default;
+
+    // Returns all invalid and overlapping entries
+    ScheduleConflicts validate() const;
+
     Q_INVOKABLE QVariant get(int index) const;
     Q_INVOKABLE void put(const QVariant &variant);
 };
 Q_DECLARE_METATYPE(QList<TemperatureDaySchedule>)
 Q_DECLARE_METATYPE(TemperatureWeekSchedule)
 
+// A TemperatureWeekSchedule flattened into a sorted array of intervals, measured in
+// seconds since Monday 00:00, for cheap lookups during zone evaluation.
+class CompiledWeekSchedule
+{
+public:
+    struct Slot {
+        int start = 0;
+        int end = 0;
+        double temperature = 0;
+    };
+
+    struct Transition {
+        QDateTime time;
+        bool scheduleActive = false;
+        double temperature = 0;
+    };
+
+    static const int secondsPerWeek = 7 * 24 * 60 * 60;
+
+    CompiledWeekSchedule() = default;
+    explicit CompiledWeekSchedule(const TemperatureWeekSchedule &weekSchedule);
+
+    static int secondOfWeek(const QDateTime &dateTime);
+
+    bool isEmpty() const;
+
+    // Returns the slot active at the given second of the week, or nullptr if none is.
+    const Slot *activeSlot(int secondOfWeek) const;
+
+    // Returns the next point in time after from where a schedule starts or ends.
+    // Returns an invalid QDateTime if there are no schedules.
+    QDateTime nextTransition(const QDateTime &from) const;
+
+    // Preview of the next count transitions after from.
+    QList<Transition> upcomingTransitions(const QDateTime &from, int count) const;
+
+private:
+    static QDateTime toDateTime(const QDate &weekStart, int secondOfWeek);
+
+    QVector<Slot> m_slots;
+    QVector<int> m_transitions;
+};
+
 //class TemperatureWeekSchedules
 //{
 //    Q_GADGET
@@ -135,5 +220,6 @@ Q_DECLARE_METATYPE(TemperatureWeekSchedule)
 QDebug operator<<(QDebug debug, const TemperatureSchedule &schedule);
 QDebug operator<<(QDebug debug, const TemperatureDaySchedule &daySchedule);
 QDebug operator<<(QDebug debug, const TemperatureWeekSchedule &weekSchedules);
+QDebug operator<<(QDebug debug, const ScheduleConflict &conflict);
 
 #endif // TEMPERATURESCHEDULE_H
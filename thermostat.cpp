@@ -24,15 +24,18 @@
 
 #include "thermostat.h"
 
+#include <QTimer>
+#include <QElapsedTimer>
 #include <QLoggingCategory>
 Q_DECLARE_LOGGING_CATEGORY(dcAirConditioning)
 
-Thermostat::Thermostat(ThingManager *thingManager, Thing *thing, QObject *parent):
+Thermostat::Thermostat(ThingRegistry *things, Thing *thing, QObject *parent):
     QObject(parent),
-    m_thingManager(thingManager),
+    m_things(things),
     m_thing(thing)
 {
-    m_cachedTargetTemperature = m_thing->stateValue("targetTemperature").toDouble();
+    updateTypes();
+    m_cachedTargetTemperature = attributeValue("targetTemperature").toDouble();
 }
 
 Thing *Thermostat::thing() const
@@ -49,86 +52,227 @@ void Thermostat::setTargetTemperature(double targetTemperature, bool force)
         return;
     }
 
-    if (m_thing->stateValue("targetTemperature").toDouble() != targetTemperature) {
-        ActionType actionType = m_thing->thingClass().actionTypes().findByName("targetTemperature");
-        Action action(actionType.id(), m_thing->id(), Action::TriggeredByRule);
-        action.setParams({Param(actionType.id(), targetTemperature)});
-        qCDebug(dcAirConditioning()) << "Setting target temperature" << targetTemperature << "to" << m_thing->name() << "from" << m_thing->stateValue("targetTemperature").toDouble();
-        ThingActionInfo *info = m_thingManager->executeAction(action);
-        connect(info, &ThingActionInfo::finished, this, [info, this](){
-            if (info->status() != Thing::ThingErrorNoError) {
-                qCWarning(dcAirConditioning()) << "Unable to execute targetTemperature action on" << m_thing << info->status() << info->displayMessage();
-                return;
-            }
-            qCDebug(dcAirConditioning()) << "Target temperature set successfully";
-        });
-    }
+    queueAction("targetTemperature", targetTemperature);
 }
 
 void Thermostat::setWindowOpen(bool windowOpen)
 {
-    m_windowOpen = windowOpen;
-
-    // First check if the device is capable of handling a window open locks
-    if (!m_thing->thingClass().actionTypes().findByName("windowOpen").id().isNull()) {
-        if (m_thing->stateValue("windowOpen").toBool() != windowOpen) {
-            ActionType actionType = m_thing->thingClass().actionTypes().findByName("windowOpen");
-            Action action(actionType.id(), m_thing->id(), Action::TriggeredByRule);
-            action.setParams({Param(actionType.id(), windowOpen)});
-            qCDebug(dcAirConditioning()) << "Setting window open" << windowOpen << "to" << m_thing->name();
-            ThingActionInfo *info = m_thingManager->executeAction(action);
-            connect(info, &ThingActionInfo::finished, this, [info, this](){
-                if (info->status() != Thing::ThingErrorNoError) {
-                    qCWarning(dcAirConditioning()) << "Unable to execute window Open action on" << m_thing << info->status() << info->displayMessage();
-                    return;
-                }
-            });
-        }
+    // Called on every zone evaluation, only start over if the desired state changed. A failed
+    // run counts as running until its retry is due.
+    if (windowOpen == m_windowOpen && (m_windowOpenPipelineRunning || m_windowOpenApplied)) {
         return;
     }
+    m_windowOpen = windowOpen;
+    m_windowOpenApplied = false;
+    m_windowOpenFailures = 0;
+    m_windowOpenPipelineRunning = true;
+    m_windowOpenSequence++;
+    runWindowOpenStep(m_windowOpenSequence, WindowOpenStepWindowOpen);
+}
 
-    // Otherwise see if it can be turned off while the window is open
-    if (m_thing->hasState("power")) {
-        if (m_thing->stateValue("power").toBool() == windowOpen) {
-            ActionType actionType = m_thing->thingClass().actionTypes().findByName("power");
-            Action action(actionType.id(), m_thing->id(), Action::TriggeredByRule);
-            action.setParams({Param(actionType.id(), !windowOpen)});
-            qCDebug(dcAirConditioning()) << "Setting power" << !windowOpen << "to" << m_thing->name();
-            ThingActionInfo *info = m_thingManager->executeAction(action);
-            connect(info, &ThingActionInfo::finished, this, [info, this](){
-                if (info->status() != Thing::ThingErrorNoError) {
-                    qCWarning(dcAirConditioning()) << "Unable to execute power action on" << m_thing << info->status() << info->displayMessage();
-                    return;
-                }
-            });
-        }
+void Thermostat::updateTypes()
+{
+    ThingClass thingClass = m_thing->thingClass();
+    m_attributeTypes.clear();
+    foreach (const QString &name, QStringList({"targetTemperature", "windowOpen", "power"})) {
+        AttributeTypes types;
+        types.actionTypeId = thingClass.actionTypes().findByName(name).id();
+        types.stateTypeId = thingClass.stateTypes().findByName(name).id();
+        m_attributeTypes.insert(name, types);
     }
+}
 
-    // If nothing works, let's assume it is a very dump radiator thermostat and set the temperature to minimum
-    double temp = windowOpen ? m_thing->state("targetTemperature").minValue().toDouble() : m_cachedTargetTemperature;
-    if (m_thing->stateValue("targetTemperature").toDouble() != temp) {
-        ActionType actionType = m_thing->thingClass().actionTypes().findByName("targetTemperature");
-        Action action(actionType.id(), m_thing->id(), Action::TriggeredByRule);
-        action.setParams({Param(actionType.id(), temp)});
-        qCDebug(dcAirConditioning()) << "Setting target temperature (window open control)" << temp << "to" << m_thing->name() << "from" << m_thing->stateValue("targetTemperature").toDouble();
-        ThingActionInfo *info = m_thingManager->executeAction(action);
-        connect(info, &ThingActionInfo::finished, this, [info, this](){
-            if (info->status() != Thing::ThingErrorNoError) {
-                qCWarning(dcAirConditioning()) << "Unable to execute targetTemperature action on" << m_thing << info->status() << info->displayMessage();
-                return;
+QVariant Thermostat::attributeValue(const QString &name) const
+{
+    return m_thing->stateValue(m_attributeTypes.value(name).stateTypeId);
+}
+
+void Thermostat::runWindowOpenStep(quint32 sequence, WindowOpenStep step)
+{
+    QString name;
+    QVariant value;
+    bool supported = false;
+    switch (step) {
+    case WindowOpenStepWindowOpen:
+        // First check if the device is capable of handling a window open locks
+        name = "windowOpen";
+        value = m_windowOpen;
+        supported = !m_attributeTypes.value(name).actionTypeId.isNull();
+        break;
+    case WindowOpenStepPower:
+        // Otherwise see if it can be turned off while the window is open
+        name = "power";
+        value = !m_windowOpen;
+        supported = !m_attributeTypes.value(name).stateTypeId.isNull() && !m_attributeTypes.value(name).actionTypeId.isNull();
+        break;
+    case WindowOpenStepTargetTemperature:
+        // If nothing works, let's assume it is a very dump radiator thermostat and set the temperature to minimum
+        name = "targetTemperature";
+        value = m_windowOpen ? m_thing->state(m_attributeTypes.value(name).stateTypeId).minValue().toDouble() : m_cachedTargetTemperature;
+        supported = true;
+        break;
+    case WindowOpenStepDone: {
+        m_windowOpenFailures++;
+        // Back off exponentially, starting at 1 second and capped at 64 seconds
+        int delay = 1000 << qMin(m_windowOpenFailures - 1, 6);
+        qCWarning(dcAirConditioning()) << "No window open strategy succeeded on" << m_thing->name() << "Retrying in" << delay << "ms";
+        QTimer::singleShot(delay, this, [this, sequence](){
+            if (sequence == m_windowOpenSequence && m_windowOpenPipelineRunning) {
+                runWindowOpenStep(sequence, WindowOpenStepWindowOpen);
             }
-            qCDebug(dcAirConditioning()) << "Target temperature set successfully";
         });
+        return;
     }
+    }
+
+    WindowOpenStep nextStep = static_cast<WindowOpenStep>(step + 1);
+    if (!supported) {
+        runWindowOpenStep(sequence, nextStep);
+        return;
+    }
+
+    if (!m_commands.value(name).inFlight && attributeValue(name) == value) {
+        qCDebug(dcAirConditioning()) << "Window open" << m_windowOpen << "already applied to" << m_thing->name() << "using" << name;
+        finishWindowOpenPipeline();
+        return;
+    }
+
+    qCDebug(dcAirConditioning()) << "Applying window open" << m_windowOpen << "to" << m_thing->name() << "using" << name << value;
+    QElapsedTimer timer;
+    timer.start();
+    queueAction(name, value, [this, sequence, name, nextStep, timer](ActionResult result){
+        if (result != ActionResultSuperseded) {
+            emit actuationStepFinished(name, result == ActionResultSuccess, timer.elapsed());
+        }
+        if (sequence != m_windowOpenSequence) {
+            // The window state changed meanwhile, a newer run has taken over
+            return;
+        }
+        switch (result) {
+        case ActionResultSuccess:
+            finishWindowOpenPipeline();
+            break;
+        case ActionResultFailed:
+            runWindowOpenStep(sequence, nextStep);
+            break;
+        case ActionResultSuperseded:
+            // Nothing failed, whoever queued the newer value is in charge of this attribute now
+            qCDebug(dcAirConditioning()) << "Window open step" << name << "on" << m_thing->name() << "superseded by a newer value";
+            finishWindowOpenPipeline();
+            break;
+        }
+    });
 }
 
-bool Thermostat::hasTemperatureSensor() const
+void Thermostat::finishWindowOpenPipeline()
 {
-    return m_thing->thingClass().interfaces().contains("temperaturesensor");
+    m_windowOpenApplied = true;
+    m_windowOpenPipelineRunning = false;
+    m_windowOpenFailures = 0;
 }
 
-double Thermostat::temperature() const
+void Thermostat::queueAction(const QString &name, const QVariant &value, ActionCallback callback)
 {
-    return m_thing->stateValue("temperature").toDouble();
+    QList<ActionCallback> supersededCallbacks;
+    Command &command = m_commands[name];
+    if (command.inFlight || command.retryScheduled) {
+        // Last writer wins. If the running action already carries the value, there's nothing left to queue.
+        if (command.inFlight && command.inFlightValue == value) {
+            command.queuedValue = QVariant();
+            supersededCallbacks = command.queuedCallbacks;
+            command.queuedCallbacks.clear();
+            if (callback) {
+                command.inFlightCallbacks.append(callback);
+            }
+        } else {
+            if (command.queuedValue != value) {
+                supersededCallbacks = command.queuedCallbacks;
+                command.queuedCallbacks.clear();
+            }
+            command.queuedValue = value;
+            if (callback) {
+                command.queuedCallbacks.append(callback);
+            }
+        }
+        foreach (const ActionCallback &supersededCallback, supersededCallbacks) {
+            supersededCallback(ActionResultSuperseded);
+        }
+        return;
+    }
+
+    if (attributeValue(name) == value) {
+        if (callback) {
+            callback(ActionResultSuccess);
+        }
+        return;
+    }
+    command.queuedValue = value;
+    if (callback) {
+        command.queuedCallbacks.append(callback);
+    }
+    executeQueuedAction(name, attributeValue(name));
 }
 
+void Thermostat::executeQueuedAction(const QString &name, const QVariant &currentValue)
+{
+    Command &command = m_commands[name];
+    command.retryScheduled = false;
+    QVariant value = command.queuedValue;
+    QList<ActionCallback> callbacks = command.queuedCallbacks;
+    command.queuedValue = QVariant();
+    command.queuedCallbacks.clear();
+    if (!value.isValid() || currentValue == value) {
+        command.failures = 0;
+        foreach (const ActionCallback &callback, callbacks) {
+            callback(ActionResultSuccess);
+        }
+        return;
+    }
+
+    ActionTypeId actionTypeId = m_attributeTypes.value(name).actionTypeId;
+    Action action(actionTypeId, m_thing->id(), Action::TriggeredByRule);
+    action.setParams({Param(actionTypeId, value)});
+    qCDebug(dcAirConditioning()) << "Setting" << name << value << "to" << m_thing->name() << "from" << attributeValue(name);
+    command.inFlight = true;
+    command.inFlightValue = value;
+    command.inFlightCallbacks = callbacks;
+    ThingActionInfo *info = m_things->executeAction(action);
+    connect(info, &ThingActionInfo::finished, this, [info, this, name, value](){
+        Command &command = m_commands[name];
+        command.inFlight = false;
+        // Callbacks may queue further actions, only call them once done with the command
+        QList<ActionCallback> callbacks = command.inFlightCallbacks;
+        command.inFlightCallbacks.clear();
+        bool success = info->status() == Thing::ThingErrorNoError;
+        if (!success) {
+            qCWarning(dcAirConditioning()) << "Unable to execute" << name << "action on" << m_thing << info->status() << info->displayMessage();
+            command.failures++;
+            // Callers waiting for the result decide on their own how to go on, only retry values nobody waits for
+            if (!command.queuedValue.isValid() && (!callbacks.isEmpty() || command.failures > maxRetries)) {
+                if (callbacks.isEmpty()) {
+                    qCWarning(dcAirConditioning()) << "Giving up setting" << name << "on" << m_thing->name() << "after" << maxRetries << "retries";
+                }
+                command.failures = 0;
+            } else {
+                if (!command.queuedValue.isValid()) {
+                    command.queuedValue = value;
+                }
+                // Back off exponentially, starting at 1 second and capped at 64 seconds
+                int delay = 1000 << qMin(command.failures - 1, 6);
+                command.retryScheduled = true;
+                QTimer::singleShot(delay, this, [this, name](){
+                    executeQueuedAction(name, attributeValue(name));
+                });
+            }
+        } else {
+            qCDebug(dcAirConditioning()) << name << "set successfully on" << m_thing->name();
+            command.failures = 0;
+            if (command.queuedValue.isValid()) {
+                executeQueuedAction(name, value);
+            }
+        }
+        foreach (const ActionCallback &callback, callbacks) {
+            callback(success ? ActionResultSuccess : ActionResultFailed);
+        }
+    });
+}
@@ -26,31 +26,90 @@
 #define THERMOSTAT_H
 
 #include <QObject>
+#include <QHash>
+
+#include <functional>
 
 #include <integrations/thing.h>
-#include <integrations/thingmanager.h>
+
+#include "thingregistry.h"
 
 class Thermostat : public QObject
 {
     Q_OBJECT
 public:
-    explicit Thermostat(ThingManager *thingManager, Thing *thing, QObject *parent = nullptr);
+    explicit Thermostat(ThingRegistry *things, Thing *thing, QObject *parent = nullptr);
 
     Thing *thing() const;
     void setTargetTemperature(double targetTemperature, bool force = false);
     void setWindowOpen(bool windowOpen);
 
-    bool hasTemperatureSensor() const;
-    double temperature() const;
+    // Resolves the action and state types in use, needs to be called when the thing class changes
+    void updateTypes();
 
 signals:
+    // Emitted for each step of reacting to a window being opened or closed, duration is in ms
+    void actuationStepFinished(const QString &step, bool success, qint64 duration);
+
+private:
+    // Strategies to react on an open window, tried in this order until one succeeds
+    enum WindowOpenStep {
+        WindowOpenStepWindowOpen,
+        WindowOpenStepPower,
+        WindowOpenStepTargetTemperature,
+        WindowOpenStepDone
+    };
+    void runWindowOpenStep(quint32 sequence, WindowOpenStep step);
+    void finishWindowOpenPipeline();
+
+    QVariant attributeValue(const QString &name) const;
+
+    enum ActionResult {
+        ActionResultSuccess,
+        ActionResultFailed,
+        // Another value has been queued before this one was sent
+        ActionResultSuperseded
+    };
+    typedef std::function<void(ActionResult result)> ActionCallback;
+    // The callback is called once the value has been set, failed or has been superseded by another value
+    void queueAction(const QString &name, const QVariant &value, ActionCallback callback = ActionCallback());
+    // currentValue is what the device is known to have, which may be ahead of the state after an action finished
+    void executeQueuedAction(const QString &name, const QVariant &currentValue);
 
 private:
-    ThingManager *m_thingManager = nullptr;
+    // Actions are tracked per name. Only one action per name is in flight at a time,
+    // newer values replace the queued one until the running action has finished.
+    struct Command {
+        bool inFlight = false;
+        QVariant inFlightValue;
+        QVariant queuedValue;
+        int failures = 0;
+        bool retryScheduled = false;
+        QList<ActionCallback> inFlightCallbacks;
+        QList<ActionCallback> queuedCallbacks;
+    };
+
+    struct AttributeTypes {
+        ActionTypeId actionTypeId;
+        StateTypeId stateTypeId;
+    };
+
+    ThingRegistry *m_things = nullptr;
     Thing *m_thing = nullptr;
 
+    QHash<QString, AttributeTypes> m_attributeTypes;
+
     double m_cachedTargetTemperature;
     bool m_windowOpen = false;
+    bool m_windowOpenApplied = false;
+    bool m_windowOpenPipelineRunning = false;
+    // Increased for every window state change, steps of outdated runs are ignored
+    quint32 m_windowOpenSequence = 0;
+    // Runs in which no strategy succeeded, retried with the same backoff as single actions
+    int m_windowOpenFailures = 0;
+
+    QHash<QString, Command> m_commands;
+    static const int maxRetries = 5;
 };
 
 #endif // THERMOSTAT_H
@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-experience-plugin-airconditioning.
+*
+* nymea-experience-plugin-airconditioning is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-experience-plugin-airconditioning is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-experience-plugin-airconditioning. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "thingregistry.h"
+
+ThingRegistry::ThingRegistry(QObject *parent):
+    QObject(parent)
+{
+
+}
+
+NymeaThingRegistry::NymeaThingRegistry(ThingManager *thingManager, QObject *parent):
+    ThingRegistry(parent),
+    m_thingManager(thingManager)
+{
+    connect(m_thingManager, &ThingManager::thingAdded, this, &ThingRegistry::thingAdded);
+    connect(m_thingManager, &ThingManager::thingRemoved, this, &ThingRegistry::thingRemoved);
+    connect(m_thingManager, &ThingManager::thingChanged, this, &ThingRegistry::thingChanged);
+    connect(m_thingManager, &ThingManager::thingStateChanged, this, &ThingRegistry::thingStateChanged);
+    connect(m_thingManager, &ThingManager::actionExecuted, this, &ThingRegistry::actionExecuted);
+}
+
+Things NymeaThingRegistry::configuredThings() const
+{
+    return m_thingManager->configuredThings();
+}
+
+Thing *NymeaThingRegistry::findConfiguredThing(const ThingId &thingId) const
+{
+    return m_thingManager->findConfiguredThing(thingId);
+}
+
+ThingActionInfo *NymeaThingRegistry::executeAction(const Action &action)
+{
+    return m_thingManager->executeAction(action);
+}
@@ -0,0 +1,67 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-experience-plugin-airconditioning.
+*
+* nymea-experience-plugin-airconditioning is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-experience-plugin-airconditioning is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-experience-plugin-airconditioning. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef THINGREGISTRY_H
+#define THINGREGISTRY_H
+
+#include <QObject>
+
+#include <integrations/thing.h>
+#include <integrations/thingmanager.h>
+
+// The things the air conditioning experience works with. In nymea this is the ThingManager,
+// the benchmark provides synthetic thermostats and sensors instead.
+class ThingRegistry : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ThingRegistry(QObject *parent = nullptr);
+
+    virtual Things configuredThings() const = 0;
+    virtual Thing *findConfiguredThing(const ThingId &thingId) const = 0;
+    virtual ThingActionInfo *executeAction(const Action &action) = 0;
+
+signals:
+    void thingAdded(Thing *thing);
+    void thingRemoved(const ThingId &thingId);
+    void thingChanged(Thing *thing);
+    void thingStateChanged(Thing *thing, const StateTypeId &stateTypeId, const QVariant &value, const QVariant &minValue, const QVariant &maxValue);
+    void actionExecuted(const Action &action, Thing::ThingError status);
+};
+
+class NymeaThingRegistry : public ThingRegistry
+{
+    Q_OBJECT
+public:
+    explicit NymeaThingRegistry(ThingManager *thingManager, QObject *parent = nullptr);
+
+    Things configuredThings() const override;
+    Thing *findConfiguredThing(const ThingId &thingId) const override;
+    ThingActionInfo *executeAction(const Action &action) override;
+
+private:
+    ThingManager *m_thingManager = nullptr;
+};
+
+#endif // THINGREGISTRY_H
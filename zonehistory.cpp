@@ -0,0 +1,265 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-experience-plugin-airconditioning.
+*
+* nymea-experience-plugin-airconditioning is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-experience-plugin-airconditioning is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-experience-plugin-airconditioning. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "zonehistory.h"
+
+#include <qmath.h>
+
+static const int rawSpacing = 5;
+static const int rawCapacity = 720;
+static const int minuteCapacity = 24 * 60;
+static const int quarterHourCapacity = 30 * 24 * 4;
+
+static qint16 toSigned16(double value)
+{
+    return static_cast<qint16>(qRound(qBound(-32768.0, value, 32767.0)));
+}
+
+static quint16 toUnsigned16(double value)
+{
+    return static_cast<quint16>(qRound(qBound(0.0, value, 65535.0)));
+}
+
+ZoneHistoryEntry::ZoneHistoryEntry()
+{
+
+}
+
+ZoneHistoryEntry::ZoneHistoryEntry(const QDateTime &timestamp, double temperature, double humidity, uint voc, double pm25, double currentSetpoint, ZoneInfo::ZoneStatus zoneStatus):
+    m_timestamp(timestamp),
+    m_temperature(temperature),
+    m_humidity(humidity),
+    m_voc(voc),
+    m_pm25(pm25),
+    m_currentSetpoint(currentSetpoint),
+    m_zoneStatus(zoneStatus)
+{
+
+}
+
+QDateTime ZoneHistoryEntry::timestamp() const
+{
+    return m_timestamp;
+}
+
+double ZoneHistoryEntry::temperature() const
+{
+    return m_temperature;
+}
+
+double ZoneHistoryEntry::humidity() const
+{
+    return m_humidity;
+}
+
+uint ZoneHistoryEntry::voc() const
+{
+    return m_voc;
+}
+
+double ZoneHistoryEntry::pm25() const
+{
+    return m_pm25;
+}
+
+double ZoneHistoryEntry::currentSetpoint() const
+{
+    return m_currentSetpoint;
+}
+
+ZoneInfo::ZoneStatus ZoneHistoryEntry::zoneStatus() const
+{
+    return m_zoneStatus;
+}
+
+QVariant ZoneHistoryEntries::get(int index) const
+{
+    return QVariant::fromValue(at(index));
+}
+
+void ZoneHistoryEntries::put(const QVariant &variant)
+{
+    append(variant.value<ZoneHistoryEntry>());
+}
+
+ZoneHistory::ZoneHistory()
+{
+    static_assert(sizeof(Sample) == 16, "memoryUsage() is documented with 16 bytes per sample");
+    m_tiers[ResolutionRaw].samples.resize(rawCapacity);
+    m_tiers[ResolutionMinute].interval = 60;
+    m_tiers[ResolutionMinute].samples.resize(minuteCapacity);
+    m_tiers[ResolutionQuarterHour].interval = 15 * 60;
+    m_tiers[ResolutionQuarterHour].samples.resize(quarterHourCapacity);
+}
+
+void ZoneHistory::record(const QDateTime &timestamp, const ZoneInfo &zone)
+{
+    qint64 secs = timestamp.toSecsSinceEpoch();
+    // Buffers are kept in order, drop anything from before a clock adjustment
+    if (secs < m_last.timestamp) {
+        return;
+    }
+
+    quint8 zoneStatus = static_cast<quint8>(zone.zoneStatus());
+
+    Tier &raw = m_tiers[ResolutionRaw];
+    Sample sample = toSample(secs, zone.temperature(), zone.humidity(), zone.voc(), zone.pm25(), zone.currentSetpoint(), zoneStatus);
+    Sample *last = raw.count > 0 ? &raw.samples[(raw.first + raw.count - 1) % raw.samples.count()] : nullptr;
+    if (last && secs - last->timestamp < rawSpacing) {
+        // Too close to the previous sample, replace it but keep its time and the flags set in between
+        sample.timestamp = last->timestamp;
+        sample.zoneStatus |= last->zoneStatus;
+        *last = sample;
+    } else {
+        append(&raw, sample);
+    }
+
+    // The previous reading has been held until now
+    if (m_last.timestamp >= 0) {
+        for (int i = ResolutionMinute; i <= ResolutionQuarterHour; i++) {
+            accumulate(&m_tiers[i], m_last, secs);
+        }
+    }
+    m_last.timestamp = secs;
+    m_last.temperature = zone.temperature();
+    m_last.humidity = zone.humidity();
+    m_last.voc = zone.voc();
+    m_last.pm25 = zone.pm25();
+    m_last.currentSetpoint = zone.currentSetpoint();
+    m_last.zoneStatus = zoneStatus;
+}
+
+ZoneHistoryEntries ZoneHistory::entries(const QDateTime &from, const QDateTime &to, Resolution resolution) const
+{
+    qint64 fromSecs = from.toSecsSinceEpoch();
+    qint64 toSecs = to.toSecsSinceEpoch();
+
+    ZoneHistoryEntries ret;
+    const Tier &tier = m_tiers[resolution];
+    for (int i = 0; i < tier.count; i++) {
+        const Sample &sample = tier.samples.at((tier.first + i) % tier.samples.count());
+        if (sample.timestamp > toSecs) {
+            break;
+        }
+        if (sample.timestamp >= fromSecs) {
+            ret.append(toEntry(sample));
+        }
+    }
+    if (tier.bucket.duration > 0 && tier.bucket.start >= fromSecs && tier.bucket.start <= toSecs) {
+        ret.append(toEntry(average(tier.bucket)));
+    }
+    return ret;
+}
+
+ZoneHistory::Resolution ZoneHistory::resolutionFor(const QDateTime &from, const QDateTime &now)
+{
+    qint64 age = from.secsTo(now);
+    if (age <= 60 * 60) {
+        return ResolutionRaw;
+    }
+    if (age <= 24 * 60 * 60) {
+        return ResolutionMinute;
+    }
+    return ResolutionQuarterHour;
+}
+
+int ZoneHistory::memoryUsage()
+{
+    return (rawCapacity + minuteCapacity + quarterHourCapacity) * static_cast<int>(sizeof(Sample));
+}
+
+ZoneHistory::Sample ZoneHistory::toSample(qint64 timestamp, double temperature, double humidity, double voc, double pm25, double currentSetpoint, quint8 zoneStatus)
+{
+    Sample sample;
+    sample.timestamp = static_cast<quint32>(timestamp);
+    sample.temperature = toSigned16(temperature * 100);
+    sample.currentSetpoint = toSigned16(currentSetpoint * 100);
+    sample.humidity = toUnsigned16(humidity * 100);
+    sample.voc = toUnsigned16(voc);
+    sample.pm25 = toUnsigned16(pm25 * 10);
+    sample.zoneStatus = zoneStatus;
+    sample.reserved = 0;
+    return sample;
+}
+
+ZoneHistoryEntry ZoneHistory::toEntry(const Sample &sample)
+{
+    return ZoneHistoryEntry(QDateTime::fromSecsSinceEpoch(sample.timestamp),
+                            sample.temperature / 100.0,
+                            sample.humidity / 100.0,
+                            sample.voc,
+                            sample.pm25 / 10.0,
+                            sample.currentSetpoint / 100.0,
+                            ZoneInfo::ZoneStatus(sample.zoneStatus));
+}
+
+void ZoneHistory::append(Tier *tier, const Sample &sample)
+{
+    int capacity = tier->samples.count();
+    if (tier->count < capacity) {
+        tier->samples[(tier->first + tier->count) % capacity] = sample;
+        tier->count++;
+    } else {
+        // Full, overwrite the oldest one
+        tier->samples[tier->first] = sample;
+        tier->first = (tier->first + 1) % capacity;
+    }
+}
+
+void ZoneHistory::accumulate(Tier *tier, const Reading &reading, qint64 until)
+{
+    // No need to fill in more intervals than the buffer holds after a long gap
+    qint64 from = qMax(reading.timestamp, until - tier->samples.count() * static_cast<qint64>(tier->interval));
+    while (from < until) {
+        qint64 start = from - from % tier->interval;
+        qint64 end = qMin(until, start + tier->interval);
+        if (tier->bucket.start != start) {
+            if (tier->bucket.duration > 0) {
+                append(tier, average(tier->bucket));
+            }
+            tier->bucket = Bucket();
+            tier->bucket.start = start;
+        }
+        qint64 duration = end - from;
+        tier->bucket.duration += duration;
+        tier->bucket.temperature += reading.temperature * duration;
+        tier->bucket.humidity += reading.humidity * duration;
+        tier->bucket.voc += reading.voc * duration;
+        tier->bucket.pm25 += reading.pm25 * duration;
+        tier->bucket.currentSetpoint += reading.currentSetpoint * duration;
+        tier->bucket.zoneStatus |= reading.zoneStatus;
+        from = end;
+    }
+}
+
+ZoneHistory::Sample ZoneHistory::average(const Bucket &bucket)
+{
+    return toSample(bucket.start,
+                    bucket.temperature / bucket.duration,
+                    bucket.humidity / bucket.duration,
+                    bucket.voc / bucket.duration,
+                    bucket.pm25 / bucket.duration,
+                    bucket.currentSetpoint / bucket.duration,
+                    bucket.zoneStatus);
+}
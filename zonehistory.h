@@ -0,0 +1,166 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-experience-plugin-airconditioning.
+*
+* nymea-experience-plugin-airconditioning is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-experience-plugin-airconditioning is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-experience-plugin-airconditioning. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef ZONEHISTORY_H
+#define ZONEHISTORY_H
+
+#include <QObject>
+#include <QDateTime>
+#include <QVariant>
+#include <QVector>
+
+#include "zoneinfo.h"
+
+class ZoneHistoryEntry
+{
+    Q_GADGET
+    Q_PROPERTY(QDateTime timestamp READ timestamp)
+    Q_PROPERTY(double temperature READ temperature)
+    Q_PROPERTY(double humidity READ humidity)
+    Q_PROPERTY(uint voc READ voc)
+    Q_PROPERTY(double pm25 READ pm25)
+    Q_PROPERTY(double currentSetpoint READ currentSetpoint)
+    Q_PROPERTY(ZoneInfo::ZoneStatus zoneStatus READ zoneStatus)
+
+public:
+    ZoneHistoryEntry();
+    ZoneHistoryEntry(const QDateTime &timestamp, double temperature, double humidity, uint voc, double pm25, double currentSetpoint, ZoneInfo::ZoneStatus zoneStatus);
+
+    QDateTime timestamp() const;
+    double temperature() const;
+    double humidity() const;
+    uint voc() const;
+    double pm25() const;
+    double currentSetpoint() const;
+    ZoneInfo::ZoneStatus zoneStatus() const;
+
+private:
+    QDateTime m_timestamp;
+    double m_temperature = 0;
+    double m_humidity = 0;
+    uint m_voc = 0;
+    double m_pm25 = 0;
+    double m_currentSetpoint = 0;
+    ZoneInfo::ZoneStatus m_zoneStatus = ZoneInfo::ZoneStatusFlagNone;
+};
+Q_DECLARE_METATYPE(ZoneHistoryEntry)
+
+class ZoneHistoryEntries: public QList<ZoneHistoryEntry>
+{
+    Q_GADGET
+    Q_PROPERTY(int count READ count)
+public:
+    ZoneHistoryEntries() = default;
+    Q_INVOKABLE QVariant get(int index) const;
+    Q_INVOKABLE void put(const QVariant &variant);
+};
+Q_DECLARE_METATYPE(QList<ZoneHistoryEntry>)
+Q_DECLARE_METATYPE(ZoneHistoryEntries)
+
+// Recent readings of a single zone, kept in memory at three resolutions:
+// - raw: every evaluation, at most one sample per 5 seconds, 720 samples (at least 1 hour)
+// - minute: 1 minute averages, 1440 samples (24 hours)
+// - quarter hour: 15 minute averages, 2880 samples (30 days)
+// All buffers are allocated upfront and samples are stored as 16 bytes of fixed point values,
+// so each zone takes 5040 * 16 bytes = ~79 KiB, no matter how long it has been running.
+// Averages are weighted by time: each reading counts for as long as it was held, until the next
+// evaluation, also across interval boundaries.
+class ZoneHistory
+{
+    Q_GADGET
+public:
+    enum Resolution {
+        ResolutionRaw,
+        ResolutionMinute,
+        ResolutionQuarterHour
+    };
+    Q_ENUM(Resolution)
+
+    ZoneHistory();
+
+    void record(const QDateTime &timestamp, const ZoneInfo &zone);
+
+    // Entries between from and to (inclusive), oldest first. The newest entry of the averaged
+    // resolutions may cover an interval that hasn't ended yet.
+    ZoneHistoryEntries entries(const QDateTime &from, const QDateTime &to, Resolution resolution) const;
+
+    // The finest resolution still reaching back to from
+    static Resolution resolutionFor(const QDateTime &from, const QDateTime &now);
+    // Bytes allocated per zone
+    static int memoryUsage();
+
+private:
+    struct Sample {
+        quint32 timestamp; // seconds since epoch
+        qint16 temperature; // 1/100 °C
+        qint16 currentSetpoint; // 1/100 °C
+        quint16 humidity; // 1/100 %
+        quint16 voc; // ppb
+        quint16 pm25; // 1/10 µg/m³
+        quint8 zoneStatus;
+        quint8 reserved;
+    };
+
+    struct Reading {
+        qint64 timestamp = -1;
+        double temperature = 0;
+        double humidity = 0;
+        double voc = 0;
+        double pm25 = 0;
+        double currentSetpoint = 0;
+        quint8 zoneStatus = 0;
+    };
+
+    // Readings weighted by how long (in seconds) they were held within the averaging interval starting at start
+    struct Bucket {
+        qint64 start = -1;
+        qint64 duration = 0;
+        double temperature = 0;
+        double humidity = 0;
+        double voc = 0;
+        double pm25 = 0;
+        double currentSetpoint = 0;
+        quint8 zoneStatus = 0;
+    };
+
+    struct Tier {
+        int interval = 0; // seconds averaged into one sample, 0 for raw samples
+        QVector<Sample> samples; // ring buffer
+        int first = 0;
+        int count = 0;
+        Bucket bucket;
+    };
+
+    static Sample toSample(qint64 timestamp, double temperature, double humidity, double voc, double pm25, double currentSetpoint, quint8 zoneStatus);
+    static ZoneHistoryEntry toEntry(const Sample &sample);
+    static void append(Tier *tier, const Sample &sample);
+    // Adds reading to the averages, held from its timestamp until the given time
+    static void accumulate(Tier *tier, const Reading &reading, qint64 until);
+    static Sample average(const Bucket &bucket);
+
+    Tier m_tiers[3];
+    Reading m_last;
+};
+
+#endif // ZONEHISTORY_H
@@ -41,6 +41,16 @@ QUuid ZoneInfo::id() const
     return m_id;
 }
 
+quint64 ZoneInfo::revision() const
+{
+    return m_revision;
+}
+
+void ZoneInfo::setRevision(quint64 revision)
+{
+    m_revision = revision;
+}
+
 QString ZoneInfo::name() const
 {
     return m_name;
@@ -93,6 +103,20 @@ QDateTime ZoneInfo::setpointOverrideEnd() const
     return m_setpointOverrideEnd;
 }
 
+bool ZoneInfo::setpointOverrideActive(const QDateTime &now) const
+{
+    switch (m_setpointOverrideMode) {
+    case SetpointOverrideModeUnlimited:
+    case SetpointOverrideModeEventual:
+        return true;
+    case SetpointOverrideModeTimed:
+        return m_setpointOverrideEnd > now;
+    case SetpointOverrideModeNone:
+        break;
+    }
+    return false;
+}
+
 QList<ThingId> ZoneInfo::thermostats() const
 {
     return m_thermostats;
@@ -219,6 +243,72 @@ void ZoneInfo::setWeekSchedule(const TemperatureWeekSchedule &weekSchedule)
     while (m_weekSchedule.count() < 7) {
         m_weekSchedule.append(TemperatureDaySchedule());
     }
+    m_compiledWeekSchedule = CompiledWeekSchedule(m_weekSchedule);
+}
+
+const CompiledWeekSchedule &ZoneInfo::compiledWeekSchedule() const
+{
+    return m_compiledWeekSchedule;
+}
+
+ZoneInfo::AggregationMode ZoneInfo::temperatureAggregation() const
+{
+    return m_temperatureAggregation;
+}
+
+void ZoneInfo::setTemperatureAggregation(AggregationMode temperatureAggregation)
+{
+    m_temperatureAggregation = temperatureAggregation;
+}
+
+ZoneInfo::AggregationMode ZoneInfo::humidityAggregation() const
+{
+    return m_humidityAggregation;
+}
+
+void ZoneInfo::setHumidityAggregation(AggregationMode humidityAggregation)
+{
+    m_humidityAggregation = humidityAggregation;
+}
+
+ZoneInfo::AggregationMode ZoneInfo::vocAggregation() const
+{
+    return m_vocAggregation;
+}
+
+void ZoneInfo::setVocAggregation(AggregationMode vocAggregation)
+{
+    m_vocAggregation = vocAggregation;
+}
+
+ZoneInfo::AggregationMode ZoneInfo::pm25Aggregation() const
+{
+    return m_pm25Aggregation;
+}
+
+void ZoneInfo::setPm25Aggregation(AggregationMode pm25Aggregation)
+{
+    m_pm25Aggregation = pm25Aggregation;
+}
+
+ZoneInfo::SmoothingFilter ZoneInfo::smoothingFilter() const
+{
+    return m_smoothingFilter;
+}
+
+void ZoneInfo::setSmoothingFilter(SmoothingFilter smoothingFilter)
+{
+    m_smoothingFilter = smoothingFilter;
+}
+
+uint ZoneInfo::smoothingWindow() const
+{
+    return m_smoothingWindow;
+}
+
+void ZoneInfo::setSmoothingWindow(uint smoothingWindow)
+{
+    m_smoothingWindow = smoothingWindow;
 }
 
 QVariant ZoneInfos::get(int index) const
@@ -55,6 +55,12 @@ class ZoneInfo
     Q_PROPERTY(uint voc READ voc)
     Q_PROPERTY(double pm25 READ pm25)
     Q_PROPERTY(TemperatureWeekSchedule weekSchedule READ weekSchedule)
+    Q_PROPERTY(AggregationMode temperatureAggregation READ temperatureAggregation)
+    Q_PROPERTY(AggregationMode humidityAggregation READ humidityAggregation)
+    Q_PROPERTY(AggregationMode vocAggregation READ vocAggregation)
+    Q_PROPERTY(AggregationMode pm25Aggregation READ pm25Aggregation)
+    Q_PROPERTY(SmoothingFilter smoothingFilter READ smoothingFilter)
+    Q_PROPERTY(uint smoothingWindow READ smoothingWindow)
 
 public:
     enum ZoneStatusFlag {
@@ -70,6 +76,25 @@ public:
 //    Q_DECLARE_OPERATORS_FOR_FLAGS(ZoneStatus)
     Q_FLAG(ZoneStatus)
 
+    // Used to tell which parts of a zone have changed
+    enum ZoneField {
+        ZoneFieldNone = 0x0000,
+        ZoneFieldName = 0x0001,
+        ZoneFieldCurrentSetpoint = 0x0002,
+        ZoneFieldStandbySetpoint = 0x0004,
+        ZoneFieldSetpointOverride = 0x0008,
+        ZoneFieldThings = 0x0010,
+        ZoneFieldZoneStatus = 0x0020,
+        ZoneFieldTemperature = 0x0040,
+        ZoneFieldHumidity = 0x0080,
+        ZoneFieldVoc = 0x0100,
+        ZoneFieldPm25 = 0x0200,
+        ZoneFieldWeekSchedule = 0x0400,
+        ZoneFieldAggregation = 0x0800,
+        ZoneFieldAll = 0x0fff
+    };
+    Q_DECLARE_FLAGS(ZoneFields, ZoneField)
+
     enum SetpointOverrideMode {
         SetpointOverrideModeNone = 0,
         SetpointOverrideModeTimed,
@@ -78,11 +103,32 @@ public:
     };
     Q_ENUM(SetpointOverrideMode)
 
+    // How the readings of multiple sensors are combined into the zone value
+    enum AggregationMode {
+        AggregationModeMax,
+        AggregationModeMean,
+        AggregationModeMedian,
+        AggregationModeTrimmedMean
+    };
+    Q_ENUM(AggregationMode)
+
+    // How the readings of each single sensor are smoothed over the last smoothingWindow readings
+    enum SmoothingFilter {
+        SmoothingFilterNone,
+        SmoothingFilterSlidingWindow,
+        SmoothingFilterExponential
+    };
+    Q_ENUM(SmoothingFilter)
+
     ZoneInfo();
     ZoneInfo(const QUuid &id);
 
     QUuid id() const;
 
+    // The manager's revision at the time this zone was changed last
+    quint64 revision() const;
+    void setRevision(quint64 revision);
+
     QString name() const;
     void setName(const QString &name);
 
@@ -96,6 +142,7 @@ public:
     void setSetpointOverride(double setpointOverride, SetpointOverrideMode mode, const QDateTime &setpointOverrideEnd = QDateTime());
     SetpointOverrideMode setpointOverrideMode() const;
     QDateTime setpointOverrideEnd() const;
+    bool setpointOverrideActive(const QDateTime &now) const;
 
     QList<ThingId> thermostats() const;
     void setThermostats(const QList<ThingId> &thermostats);
@@ -133,9 +180,29 @@ public:
 
     TemperatureWeekSchedule weekSchedule() const;
     void setWeekSchedule(const TemperatureWeekSchedule &weekSchedule);
+    const CompiledWeekSchedule &compiledWeekSchedule() const;
+
+    AggregationMode temperatureAggregation() const;
+    void setTemperatureAggregation(AggregationMode temperatureAggregation);
+
+    AggregationMode humidityAggregation() const;
+    void setHumidityAggregation(AggregationMode humidityAggregation);
+
+    AggregationMode vocAggregation() const;
+    void setVocAggregation(AggregationMode vocAggregation);
+
+    AggregationMode pm25Aggregation() const;
+    void setPm25Aggregation(AggregationMode pm25Aggregation);
+
+    SmoothingFilter smoothingFilter() const;
+    void setSmoothingFilter(SmoothingFilter smoothingFilter);
+
+    uint smoothingWindow() const;
+    void setSmoothingWindow(uint smoothingWindow);
 
 private:
     QUuid m_id;
+    quint64 m_revision = 0;
     QString m_name;
     double m_currentSetpoint = 0;
     double m_standbySetpoint = 18;
@@ -154,6 +221,13 @@ private:
     uint m_voc = 0;
     double m_pm25 = 0;
     TemperatureWeekSchedule m_weekSchedule;
+    CompiledWeekSchedule m_compiledWeekSchedule;
+    AggregationMode m_temperatureAggregation = AggregationModeMax;
+    AggregationMode m_humidityAggregation = AggregationModeMax;
+    AggregationMode m_vocAggregation = AggregationModeMax;
+    AggregationMode m_pm25Aggregation = AggregationModeMax;
+    SmoothingFilter m_smoothingFilter = SmoothingFilterNone;
+    uint m_smoothingWindow = 5;
 };
 Q_DECLARE_METATYPE(ZoneInfo)
 
@@ -0,0 +1,38 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-experience-plugin-airconditioning.
+*
+* nymea-experience-plugin-airconditioning is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-experience-plugin-airconditioning is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-experience-plugin-airconditioning. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef ZONESTATUSTHRESHOLDS_H
+#define ZONESTATUSTHRESHOLDS_H
+
+#include <QtGlobal>
+
+// Status flags switch on when reaching the enter threshold and off only once below the exit threshold
+static const double highHumidityEnter = 65; // > 60 over longer periods of time may cause mould, 70 will cause mould
+static const double highHumidityExit = 60;
+static const uint badAirVocEnter = 660; // 660 Moderate as of IAQ
+static const uint badAirVocExit = 600;
+static const double badAirPm25Enter = 25; // 25 Moderate as of CAQI
+static const double badAirPm25Exit = 20;
+
+#endif // ZONESTATUSTHRESHOLDS_H
@@ -0,0 +1,469 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-experience-plugin-airconditioning.
+*
+* nymea-experience-plugin-airconditioning is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-experience-plugin-airconditioning is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-experience-plugin-airconditioning. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "zonestorage.h"
+
+#include <QSettings>
+#include <QSaveFile>
+#include <QFile>
+#include <QFileInfo>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QMetaEnum>
+#include <QLoggingCategory>
+
+Q_DECLARE_LOGGING_CATEGORY(dcAirConditioning)
+
+// "NACZ"
+static const quint32 binaryMagic = 0x4e41435a;
+// Use a fixed data stream version so the file can be read by Qt 5 and Qt 6 builds alike
+static const QDataStream::Version binaryStreamVersion = QDataStream::Qt_5_12;
+
+ZoneStorage::ZoneStorage(const QString &path):
+    m_iniFileName(path + "/airconditioning.conf"),
+    m_binaryFileName(path + "/airconditioning.zones")
+{
+
+}
+
+QString ZoneStorage::iniFileName() const
+{
+    return m_iniFileName;
+}
+
+QString ZoneStorage::binaryFileName() const
+{
+    return m_binaryFileName;
+}
+
+QList<ZoneInfo> ZoneStorage::load()
+{
+    m_serializedZones.clear();
+
+    if (QFile::exists(m_binaryFileName)) {
+        bool ok = false;
+        QList<QByteArray> corruptZones;
+        QList<ZoneInfo> zones = loadBinary(m_binaryFileName, &ok, &corruptZones);
+        if (ok) {
+            foreach (const ZoneInfo &zone, zones) {
+                m_serializedZones.insert(zone.id(), serialize(zone));
+            }
+            // Write entries we can't read back unchanged, under a key no zone will ever have
+            foreach (const QByteArray &data, corruptZones) {
+                m_serializedZones.insert(QUuid::createUuid(), data);
+            }
+            return zones;
+        }
+        qCWarning(dcAirConditioning()) << "Unable to load zones from" << m_binaryFileName << ". Not touching the zone store to prevent data loss.";
+        m_readOnly = true;
+        return QList<ZoneInfo>();
+    }
+
+    if (!QFile::exists(m_iniFileName)) {
+        return QList<ZoneInfo>();
+    }
+
+    // One time migration from the old settings file
+    qCInfo(dcAirConditioning()) << "Migrating zones from" << m_iniFileName << "to" << m_binaryFileName;
+    QList<ZoneInfo> zones = loadIni(m_iniFileName);
+    foreach (const ZoneInfo &zone, zones) {
+        m_serializedZones.insert(zone.id(), serialize(zone));
+    }
+    if (!writeBinary()) {
+        qCWarning(dcAirConditioning()) << "Migration failed. Keeping" << m_iniFileName;
+        return zones;
+    }
+    QFile::rename(m_iniFileName, m_iniFileName + ".migrated");
+    return zones;
+}
+
+bool ZoneStorage::save(const QHash<QUuid, ZoneInfo> &zones, const QSet<QUuid> &changedZones)
+{
+    if (m_readOnly) {
+        qCWarning(dcAirConditioning()) << "Zone store could not be loaded. Not saving zones.";
+        return false;
+    }
+
+    // Only the changed zones are serialized again, the rest is taken from the cache
+    foreach (const QUuid &zoneId, changedZones) {
+        if (zones.contains(zoneId)) {
+            m_serializedZones.insert(zoneId, serialize(zones.value(zoneId)));
+        } else {
+            m_serializedZones.remove(zoneId);
+        }
+    }
+    return writeBinary();
+}
+
+QList<ZoneInfo> ZoneStorage::loadIni(const QString &fileName)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QList<ZoneInfo> zones;
+    QSettings settings(fileName, QSettings::IniFormat);
+
+    settings.beginGroup("zones");
+    qCDebug(dcAirConditioning()) << "child groups of zones" << settings.childKeys() << settings.childGroups();
+    foreach (const QString &key, settings.childGroups()) {
+        settings.beginGroup(key);
+        qCDebug(dcAirConditioning()) << "Loading zone" << key;
+        QUuid zoneId(key);
+        ZoneInfo zone(zoneId);
+        zone.setName(settings.value("name").toString());
+        QMetaEnum modeEnum = QMetaEnum::fromType<ZoneInfo::SetpointOverrideMode>();
+        ZoneInfo::SetpointOverrideMode mode = static_cast<ZoneInfo::SetpointOverrideMode>(modeEnum.keyToValue(settings.value("setpointOverrideMode", "SetpointOverrideModeNone").toByteArray()));
+        zone.setSetpointOverride(settings.value("setpointOverride").toDouble(), mode, settings.value("setpointOverrideEnd").toDateTime());
+        zone.setStandbySetpoint(settings.value("standbySetpoint").toDouble());
+        settings.beginGroup("weekSchedule");
+        TemperatureWeekSchedule weekSchedule;
+        for (int day = 0; day < 7; day++) {
+            TemperatureDaySchedule daySchedule;
+            settings.beginGroup(QString::number(day));
+            foreach (const QString &childGroup, settings.childGroups()) {
+                settings.beginGroup(childGroup);
+                QTime startTime = settings.value("startTime").toTime();
+                QTime endTime = settings.value("endTime").toTime();
+                double temperature = settings.value("temperature").toDouble();
+                TemperatureSchedule schedule(startTime, endTime, temperature);
+                daySchedule.append(schedule);
+                settings.endGroup(); // schedule
+            }
+            weekSchedule.append(daySchedule);
+            settings.endGroup(); // daySchedule
+        }
+        settings.endGroup(); // weekSchedule
+        zone.setWeekSchedule(weekSchedule);
+
+        QList<ThingId> thermostats, valves, windowSensors, indoorSensors, outdoorSensors, notifications;
+        foreach (const QString &thingId, settings.value("thermostats").toStringList()) {
+            thermostats.append(ThingId(thingId));
+        }
+        zone.setThermostats(thermostats);
+        foreach (const QString &thingId, settings.value("valves").toStringList()) {
+            valves.append(ThingId(thingId));
+        }
+        zone.setValves(valves);
+        foreach (const QString &thingId, settings.value("windowSensors").toStringList()) {
+            windowSensors.append(ThingId(thingId));
+        }
+        zone.setWindowSensors(windowSensors);
+        foreach (const QString &thingId, settings.value("indoorSensors").toStringList()) {
+            indoorSensors.append(ThingId(thingId));
+        }
+        zone.setIndoorSensors(indoorSensors);
+        foreach (const QString &thingId, settings.value("outdoorSensors").toStringList()) {
+            outdoorSensors.append(ThingId(thingId));
+        }
+        zone.setOutdoorSensors(outdoorSensors);
+        foreach (const QString &thingId, settings.value("notifications").toStringList()) {
+            notifications.append(ThingId(thingId));
+        }
+        zone.setNotifications(notifications);
+
+        zones.append(zone);
+        settings.endGroup(); // zone
+    }
+    settings.endGroup(); // zones
+
+    qCInfo(dcAirConditioning()) << "Loaded" << zones.count() << "zones from" << fileName << "in" << timer.nsecsElapsed() / 1000 << "us";
+    return zones;
+}
+
+void ZoneStorage::saveIni(const QString &fileName, const QHash<QUuid, ZoneInfo> &zones, const QSet<QUuid> &changedZones)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QSettings settings(fileName, QSettings::IniFormat);
+    settings.beginGroup("zones");
+    foreach (const QUuid &zoneId, changedZones) {
+        // Clear the entire group, the number of schedule entries may have shrunk
+        settings.remove(zoneId.toString());
+        if (!zones.contains(zoneId)) {
+            continue;
+        }
+        const ZoneInfo zone = zones.value(zoneId);
+        settings.beginGroup(zone.id().toString());
+        settings.setValue("name", zone.name());
+        settings.setValue("standbySetpoint", zone.standbySetpoint());
+        settings.setValue("setpointOverride", zone.setpointOverride());
+        QMetaEnum modeEnum = QMetaEnum::fromType<ZoneInfo::SetpointOverrideMode>();
+        settings.setValue("setpointOverrideMode", modeEnum.valueToKey(zone.setpointOverrideMode()));
+        settings.setValue("setpointOverrideEnd", zone.setpointOverrideEnd());
+
+        settings.beginGroup("weekSchedule");
+        const TemperatureWeekSchedule weekSchedule = zone.weekSchedule();
+        for (int day = 0; day < 7; day++) {
+            settings.beginGroup(QString::number(day));
+            const TemperatureDaySchedule &daySchedule = weekSchedule.at(day);
+            for (int i = 0; i < daySchedule.count(); i++) {
+                const TemperatureSchedule &schedule = daySchedule.at(i);
+                settings.beginGroup(QString::number(i));
+                settings.setValue("startTime", schedule.startTime());
+                settings.setValue("endTime", schedule.endTime());
+                settings.setValue("temperature", schedule.temperature());
+                settings.endGroup(); // schedule
+            }
+            settings.endGroup(); // daySchedule
+        }
+        settings.endGroup(); // weekSchedule
+
+        QStringList thermostats, valves, windowSensors, indoorSensors, outdoorSensors, notifications;
+        foreach (const ThingId &thingId, zone.thermostats()) {
+            thermostats.append(thingId.toString());
+        }
+        settings.setValue("thermostats", thermostats);
+        foreach (const ThingId &thingId, zone.valves()) {
+            valves.append(thingId.toString());
+        }
+        settings.setValue("valves", valves);
+        foreach (const ThingId &thingId, zone.windowSensors()) {
+            windowSensors.append(thingId.toString());
+        }
+        settings.setValue("windowSensors", windowSensors);
+        foreach (const ThingId &thingId, zone.indoorSensors()) {
+            indoorSensors.append(thingId.toString());
+        }
+        settings.setValue("indoorSensors", indoorSensors);
+        foreach (const ThingId &thingId, zone.outdoorSensors()) {
+            outdoorSensors.append(thingId.toString());
+        }
+        settings.setValue("outdoorSensors", outdoorSensors);
+
+        foreach (const ThingId &thingId, zone.notifications()) {
+            notifications.append(thingId.toString());
+        }
+        settings.setValue("notifications", notifications);
+
+        settings.endGroup(); // zone
+    }
+    settings.endGroup();
+
+    settings.sync();
+    qCDebug(dcAirConditioning()) << "Saved" << changedZones.count() << "zones to" << fileName << "in" << timer.nsecsElapsed() / 1000 << "us";
+}
+
+QList<ZoneInfo> ZoneStorage::loadBinary(const QString &fileName, bool *ok, QList<QByteArray> *corruptZones)
+{
+    *ok = false;
+    QElapsedTimer timer;
+    timer.start();
+
+    QList<ZoneInfo> zones;
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly)) {
+        qCWarning(dcAirConditioning()) << "Unable to open" << fileName << file.errorString();
+        return zones;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(binaryStreamVersion);
+
+    quint32 magic;
+    quint16 schemaVersion;
+    stream >> magic >> schemaVersion;
+    if (magic != binaryMagic) {
+        qCWarning(dcAirConditioning()) << fileName << "is not a zone store";
+        return zones;
+    }
+    if (schemaVersion > currentSchemaVersion) {
+        qCWarning(dcAirConditioning()) << fileName << "has been written by a newer version (schema" << schemaVersion << ")";
+        return zones;
+    }
+
+    quint32 count;
+    stream >> count;
+    for (quint32 i = 0; i < count; i++) {
+        QByteArray data;
+        stream >> data;
+        if (stream.status() != QDataStream::Ok) {
+            qCWarning(dcAirConditioning()) << fileName << "is truncated";
+            return QList<ZoneInfo>();
+        }
+        bool zoneOk = false;
+        ZoneInfo zone = deserialize(data, schemaVersion, &zoneOk);
+        if (!zoneOk) {
+            qCWarning(dcAirConditioning()) << "Skipping corrupt zone entry in" << fileName;
+            if (corruptZones) {
+                corruptZones->append(data);
+            }
+            continue;
+        }
+        zones.append(zone);
+    }
+
+    *ok = true;
+    qCInfo(dcAirConditioning()) << "Loaded" << zones.count() << "zones from" << fileName << "in" << timer.nsecsElapsed() / 1000 << "us";
+    return zones;
+}
+
+bool ZoneStorage::saveBinary(const QString &fileName, const QList<ZoneInfo> &zones)
+{
+    QList<QByteArray> serializedZones;
+    foreach (const ZoneInfo &zone, zones) {
+        serializedZones.append(serialize(zone));
+    }
+    return writeBinary(fileName, serializedZones);
+}
+
+bool ZoneStorage::writeBinary()
+{
+    return writeBinary(m_binaryFileName, m_serializedZones.values());
+}
+
+bool ZoneStorage::writeBinary(const QString &fileName, const QList<QByteArray> &serializedZones)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // QSaveFile writes to a temporary file and renames it on commit, the old file stays intact on failure
+    QSaveFile file(fileName);
+    if (!file.open(QFile::WriteOnly)) {
+        qCWarning(dcAirConditioning()) << "Unable to open" << fileName << "for writing:" << file.errorString();
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(binaryStreamVersion);
+    stream << binaryMagic << currentSchemaVersion;
+    stream << static_cast<quint32>(serializedZones.count());
+    foreach (const QByteArray &data, serializedZones) {
+        stream << data;
+    }
+
+    if (stream.status() != QDataStream::Ok || !file.commit()) {
+        qCWarning(dcAirConditioning()) << "Unable to write" << fileName << file.errorString();
+        return false;
+    }
+    qCDebug(dcAirConditioning()) << "Saved" << serializedZones.count() << "zones to" << fileName << "in" << timer.nsecsElapsed() / 1000 << "us";
+    return true;
+}
+
+QByteArray ZoneStorage::serialize(const ZoneInfo &zone)
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(binaryStreamVersion);
+
+    stream << zone.id();
+    stream << zone.name();
+    stream << zone.standbySetpoint();
+    stream << zone.setpointOverride();
+    stream << static_cast<quint8>(zone.setpointOverrideMode());
+    stream << zone.setpointOverrideEnd();
+
+    const TemperatureWeekSchedule weekSchedule = zone.weekSchedule();
+    stream << static_cast<quint8>(weekSchedule.count());
+    foreach (const TemperatureDaySchedule &daySchedule, weekSchedule) {
+        stream << static_cast<quint16>(daySchedule.count());
+        foreach (const TemperatureSchedule &schedule, daySchedule) {
+            stream << schedule.startTime() << schedule.endTime() << schedule.temperature();
+        }
+    }
+
+    const QList<QList<ThingId>> thingIdLists = {zone.thermostats(), zone.valves(), zone.windowSensors(), zone.indoorSensors(), zone.outdoorSensors(), zone.notifications()};
+    foreach (const QList<ThingId> &thingIds, thingIdLists) {
+        stream << static_cast<quint16>(thingIds.count());
+        foreach (const ThingId &thingId, thingIds) {
+            stream << static_cast<QUuid>(thingId);
+        }
+    }
+
+    stream << static_cast<quint8>(zone.temperatureAggregation());
+    stream << static_cast<quint8>(zone.humidityAggregation());
+    stream << static_cast<quint8>(zone.vocAggregation());
+    stream << static_cast<quint8>(zone.pm25Aggregation());
+    stream << static_cast<quint8>(zone.smoothingFilter());
+    stream << static_cast<quint8>(zone.smoothingWindow());
+    return data;
+}
+
+ZoneInfo ZoneStorage::deserialize(const QByteArray &data, quint16 schemaVersion, bool *ok)
+{
+    QDataStream stream(data);
+    stream.setVersion(binaryStreamVersion);
+
+    QUuid zoneId;
+    QString name;
+    double standbySetpoint, setpointOverride;
+    quint8 setpointOverrideMode;
+    QDateTime setpointOverrideEnd;
+    stream >> zoneId >> name >> standbySetpoint >> setpointOverride >> setpointOverrideMode >> setpointOverrideEnd;
+
+    ZoneInfo zone(zoneId);
+    zone.setName(name);
+    zone.setStandbySetpoint(standbySetpoint);
+    zone.setSetpointOverride(setpointOverride, static_cast<ZoneInfo::SetpointOverrideMode>(setpointOverrideMode), setpointOverrideEnd);
+
+    TemperatureWeekSchedule weekSchedule;
+    quint8 days;
+    stream >> days;
+    for (int day = 0; day < days; day++) {
+        TemperatureDaySchedule daySchedule;
+        quint16 count;
+        stream >> count;
+        for (int i = 0; i < count; i++) {
+            QTime startTime, endTime;
+            double temperature;
+            stream >> startTime >> endTime >> temperature;
+            daySchedule.append(TemperatureSchedule(startTime, endTime, temperature));
+        }
+        weekSchedule.append(daySchedule);
+    }
+    zone.setWeekSchedule(weekSchedule);
+
+    QList<QList<ThingId>> thingIdLists;
+    for (int list = 0; list < 6; list++) {
+        QList<ThingId> thingIds;
+        quint16 count;
+        stream >> count;
+        for (int i = 0; i < count; i++) {
+            QUuid thingId;
+            stream >> thingId;
+            thingIds.append(ThingId(thingId));
+        }
+        thingIdLists.append(thingIds);
+    }
+    zone.setThermostats(thingIdLists.at(0));
+    zone.setValves(thingIdLists.at(1));
+    zone.setWindowSensors(thingIdLists.at(2));
+    zone.setIndoorSensors(thingIdLists.at(3));
+    zone.setOutdoorSensors(thingIdLists.at(4));
+    zone.setNotifications(thingIdLists.at(5));
+
+    if (schemaVersion >= 2) {
+        quint8 temperatureAggregation, humidityAggregation, vocAggregation, pm25Aggregation, smoothingFilter, smoothingWindow;
+        stream >> temperatureAggregation >> humidityAggregation >> vocAggregation >> pm25Aggregation >> smoothingFilter >> smoothingWindow;
+        zone.setTemperatureAggregation(static_cast<ZoneInfo::AggregationMode>(temperatureAggregation));
+        zone.setHumidityAggregation(static_cast<ZoneInfo::AggregationMode>(humidityAggregation));
+        zone.setVocAggregation(static_cast<ZoneInfo::AggregationMode>(vocAggregation));
+        zone.setPm25Aggregation(static_cast<ZoneInfo::AggregationMode>(pm25Aggregation));
+        zone.setSmoothingFilter(static_cast<ZoneInfo::SmoothingFilter>(smoothingFilter));
+        zone.setSmoothingWindow(smoothingWindow);
+    }
+
+    *ok = stream.status() == QDataStream::Ok && !zoneId.isNull();
+    return zone;
+}
@@ -0,0 +1,74 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-experience-plugin-airconditioning.
+*
+* nymea-experience-plugin-airconditioning is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-experience-plugin-airconditioning is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-experience-plugin-airconditioning. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef ZONESTORAGE_H
+#define ZONESTORAGE_H
+
+#include <QHash>
+#include <QSet>
+#include <QUuid>
+
+#include "zoneinfo.h"
+
+// Persists zones in a compact binary file. Every zone is stored as a length prefixed
+// blob after a header with magic and schema version. Writes go to a temporary file
+// which atomically replaces the old one. The INI format used by earlier versions is
+// migrated on first load.
+class ZoneStorage
+{
+public:
+    // 2: Aggregation modes and smoothing
+    static const quint16 currentSchemaVersion = 2;
+
+    explicit ZoneStorage(const QString &path);
+
+    QString iniFileName() const;
+    QString binaryFileName() const;
+
+    QList<ZoneInfo> load();
+    bool save(const QHash<QUuid, ZoneInfo> &zones, const QSet<QUuid> &changedZones);
+
+    static QList<ZoneInfo> loadIni(const QString &fileName);
+    static void saveIni(const QString &fileName, const QHash<QUuid, ZoneInfo> &zones, const QSet<QUuid> &changedZones);
+
+    // Entries which can't be deserialized are skipped and, if given, returned in corruptZones
+    static QList<ZoneInfo> loadBinary(const QString &fileName, bool *ok, QList<QByteArray> *corruptZones = nullptr);
+    static bool saveBinary(const QString &fileName, const QList<ZoneInfo> &zones);
+
+private:
+    bool writeBinary();
+    static bool writeBinary(const QString &fileName, const QList<QByteArray> &serializedZones);
+
+    static QByteArray serialize(const ZoneInfo &zone);
+    static ZoneInfo deserialize(const QByteArray &data, quint16 schemaVersion, bool *ok);
+
+private:
+    QString m_iniFileName;
+    QString m_binaryFileName;
+    bool m_readOnly = false;
+
+    QHash<QUuid, QByteArray> m_serializedZones;
+};
+
+#endif // ZONESTORAGE_H
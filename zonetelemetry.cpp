@@ -0,0 +1,435 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-experience-plugin-airconditioning.
+*
+* nymea-experience-plugin-airconditioning is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-experience-plugin-airconditioning is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-experience-plugin-airconditioning. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "zonetelemetry.h"
+
+#include <QThread>
+#include <QTimer>
+#include <QMetaEnum>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QLoggingCategory>
+
+Q_DECLARE_LOGGING_CATEGORY(dcAirConditioning)
+
+static const int schemaVersion = 1;
+
+// Batching
+static const int flushInterval = 5 * 60 * 1000;
+static const int maxBatchSize = 1000;
+static const qint64 readingInterval = 60;
+
+// Retention
+static const qint64 rawRetention = 7 * 24 * 60 * 60;
+static const qint64 downsampledInterval = 60 * 60;
+static const qint64 longTermRetention = 2 * 365 * 24 * 60 * 60;
+static const qint64 retentionInterval = 6 * 60 * 60;
+
+enum ReadingResolution {
+    ReadingResolutionRaw = 0,
+    ReadingResolutionHourly = 1
+};
+
+// Flags for which transitions are recorded
+static const ZoneInfo::ZoneStatusFlag transitionFlags[] = {
+    ZoneInfo::ZoneStatusFlagSetpointOverrideActive,
+    ZoneInfo::ZoneStatusFlagWindowOpen,
+    ZoneInfo::ZoneStatusFlagBadAir,
+    ZoneInfo::ZoneStatusFlagHighHumidity
+};
+
+ZoneTelemetryWriter::ZoneTelemetryWriter(const QString &fileName):
+    QObject(),
+    m_fileName(fileName),
+    m_connectionName("airconditioning-telemetry")
+{
+
+}
+
+void ZoneTelemetryWriter::open()
+{
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", m_connectionName);
+    db.setDatabaseName(m_fileName);
+    if (!db.open()) {
+        qCWarning(dcAirConditioning()) << "Unable to open telemetry database" << m_fileName << db.lastError().text();
+        return;
+    }
+
+    // WAL keeps readers and the single writer apart and needs fewer syncs per transaction
+    exec("PRAGMA journal_mode = WAL");
+    exec("PRAGMA synchronous = NORMAL");
+
+    QSqlQuery query(db);
+    query.exec("PRAGMA user_version");
+    int version = query.next() ? query.value(0).toInt() : 0;
+    if (version > schemaVersion) {
+        qCWarning(dcAirConditioning()) << "Telemetry database has been written by a newer version" << version << "Not writing to it.";
+        db.close();
+        return;
+    }
+
+    bool ok = exec("CREATE TABLE IF NOT EXISTS readings ("
+                   "zoneId TEXT NOT NULL, "
+                   "timestamp INTEGER NOT NULL, "
+                   "resolution INTEGER NOT NULL, "
+                   "temperature REAL, "
+                   "humidity REAL, "
+                   "voc INTEGER, "
+                   "pm25 REAL, "
+                   "currentSetpoint REAL, "
+                   "zoneStatus INTEGER)")
+            && exec("CREATE INDEX IF NOT EXISTS readingsByZone ON readings (zoneId, timestamp)")
+            && exec("CREATE INDEX IF NOT EXISTS readingsByResolution ON readings (resolution, timestamp)")
+            && exec("CREATE TABLE IF NOT EXISTS transitions ("
+                    "zoneId TEXT NOT NULL, "
+                    "timestamp INTEGER NOT NULL, "
+                    "flag INTEGER NOT NULL, "
+                    "active INTEGER NOT NULL)")
+            && exec("CREATE INDEX IF NOT EXISTS transitionsByZone ON transitions (zoneId, timestamp)")
+            && exec(QString("PRAGMA user_version = %1").arg(schemaVersion));
+    if (!ok) {
+        db.close();
+        return;
+    }
+    m_open = true;
+    qCDebug(dcAirConditioning()) << "Telemetry database opened:" << m_fileName;
+}
+
+void ZoneTelemetryWriter::close()
+{
+    m_open = false;
+    {
+        QSqlDatabase db = QSqlDatabase::database(m_connectionName, false);
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(m_connectionName);
+}
+
+void ZoneTelemetryWriter::write(const QList<ZoneReading> &readings, const QList<ZoneTransition> &transitions, qint64 now)
+{
+    if (!m_open) {
+        return;
+    }
+
+    QSqlDatabase db = QSqlDatabase::database(m_connectionName);
+    db.transaction();
+
+    QSqlQuery query(db);
+    query.prepare("INSERT INTO readings (zoneId, timestamp, resolution, temperature, humidity, voc, pm25, currentSetpoint, zoneStatus) "
+                  "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)");
+    foreach (const ZoneReading &reading, readings) {
+        query.addBindValue(reading.zoneId.toString());
+        query.addBindValue(reading.timestamp);
+        query.addBindValue(static_cast<int>(ReadingResolutionRaw));
+        query.addBindValue(reading.temperature);
+        query.addBindValue(reading.humidity);
+        query.addBindValue(reading.voc);
+        query.addBindValue(reading.pm25);
+        query.addBindValue(reading.currentSetpoint);
+        query.addBindValue(reading.zoneStatus);
+        if (!query.exec()) {
+            qCWarning(dcAirConditioning()) << "Unable to store zone reading:" << query.lastError().text();
+            db.rollback();
+            return;
+        }
+    }
+
+    query.prepare("INSERT INTO transitions (zoneId, timestamp, flag, active) VALUES (?, ?, ?, ?)");
+    foreach (const ZoneTransition &transition, transitions) {
+        query.addBindValue(transition.zoneId.toString());
+        query.addBindValue(transition.timestamp);
+        query.addBindValue(static_cast<int>(transition.flag));
+        query.addBindValue(transition.active);
+        if (!query.exec()) {
+            qCWarning(dcAirConditioning()) << "Unable to store zone transition:" << query.lastError().text();
+            db.rollback();
+            return;
+        }
+    }
+
+    if (!db.commit()) {
+        qCWarning(dcAirConditioning()) << "Unable to commit telemetry:" << db.lastError().text();
+        return;
+    }
+    qCDebug(dcAirConditioning()) << "Stored" << readings.count() << "zone readings and" << transitions.count() << "transitions";
+
+    if (now - m_lastRetention >= retentionInterval) {
+        m_lastRetention = now;
+        applyRetention(now);
+    }
+}
+
+void ZoneTelemetryWriter::removeZone(const QUuid &zoneId)
+{
+    if (!m_open) {
+        return;
+    }
+
+    QSqlDatabase db = QSqlDatabase::database(m_connectionName);
+    db.transaction();
+    QSqlQuery query(db);
+    query.prepare("DELETE FROM readings WHERE zoneId = ?");
+    query.addBindValue(zoneId.toString());
+    query.exec();
+    query.prepare("DELETE FROM transitions WHERE zoneId = ?");
+    query.addBindValue(zoneId.toString());
+    query.exec();
+    db.commit();
+}
+
+void ZoneTelemetryWriter::fetch(int requestId, const QUuid &zoneId, qint64 from, qint64 to)
+{
+    ZoneHistoryEntries readings;
+    QList<ZoneTransition> transitions;
+    if (!m_open) {
+        emit fetchFinished(requestId, readings, transitions);
+        return;
+    }
+
+    QSqlDatabase db = QSqlDatabase::database(m_connectionName);
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare("SELECT timestamp, temperature, humidity, voc, pm25, currentSetpoint, zoneStatus FROM readings "
+                  "WHERE zoneId = ? AND timestamp BETWEEN ? AND ? ORDER BY timestamp");
+    query.addBindValue(zoneId.toString());
+    query.addBindValue(from);
+    query.addBindValue(to);
+    if (query.exec()) {
+        while (query.next()) {
+            readings.append(ZoneHistoryEntry(QDateTime::fromSecsSinceEpoch(query.value(0).toLongLong()),
+                                             query.value(1).toDouble(),
+                                             query.value(2).toDouble(),
+                                             query.value(3).toUInt(),
+                                             query.value(4).toDouble(),
+                                             query.value(5).toDouble(),
+                                             ZoneInfo::ZoneStatus(query.value(6).toInt())));
+        }
+    } else {
+        qCWarning(dcAirConditioning()) << "Unable to fetch zone readings:" << query.lastError().text();
+    }
+
+    query.prepare("SELECT timestamp, flag, active FROM transitions WHERE zoneId = ? AND timestamp BETWEEN ? AND ? ORDER BY timestamp");
+    query.addBindValue(zoneId.toString());
+    query.addBindValue(from);
+    query.addBindValue(to);
+    if (query.exec()) {
+        while (query.next()) {
+            ZoneTransition transition;
+            transition.zoneId = zoneId;
+            transition.timestamp = query.value(0).toLongLong();
+            transition.flag = static_cast<ZoneInfo::ZoneStatusFlag>(query.value(1).toInt());
+            transition.active = query.value(2).toBool();
+            transitions.append(transition);
+        }
+    } else {
+        qCWarning(dcAirConditioning()) << "Unable to fetch zone transitions:" << query.lastError().text();
+    }
+
+    emit fetchFinished(requestId, readings, transitions);
+}
+
+bool ZoneTelemetryWriter::exec(const QString &statement)
+{
+    QSqlQuery query(QSqlDatabase::database(m_connectionName));
+    if (!query.exec(statement)) {
+        qCWarning(dcAirConditioning()) << "Telemetry database error:" << statement << query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+void ZoneTelemetryWriter::applyRetention(qint64 now)
+{
+    // Only fold complete hours
+    qint64 rawCutoff = now - rawRetention;
+    rawCutoff -= rawCutoff % downsampledInterval;
+    qint64 longTermCutoff = now - longTermRetention;
+
+    // SQLite has no bitwise OR aggregate, so OR the status flags one by one
+    QStringList statusFlags;
+    QMetaEnum flagEnum = QMetaEnum::fromType<ZoneInfo::ZoneStatusFlag>();
+    for (int i = 0; i < flagEnum.keyCount(); i++) {
+        if (flagEnum.value(i) != ZoneInfo::ZoneStatusFlagNone) {
+            statusFlags.append(QString("MAX(zoneStatus & %1)").arg(flagEnum.value(i)));
+        }
+    }
+
+    QSqlDatabase db = QSqlDatabase::database(m_connectionName);
+    db.transaction();
+    QSqlQuery query(db);
+    query.prepare(QString("INSERT INTO readings (zoneId, timestamp, resolution, temperature, humidity, voc, pm25, currentSetpoint, zoneStatus) "
+                          "SELECT zoneId, timestamp - timestamp % %1, %2, AVG(temperature), AVG(humidity), CAST(ROUND(AVG(voc)) AS INTEGER), AVG(pm25), AVG(currentSetpoint), %3 "
+                          "FROM readings WHERE resolution = %4 AND timestamp < ? "
+                          "GROUP BY zoneId, timestamp - timestamp % %1")
+                  .arg(downsampledInterval).arg(static_cast<int>(ReadingResolutionHourly)).arg(statusFlags.join(" | ")).arg(static_cast<int>(ReadingResolutionRaw)));
+    query.addBindValue(rawCutoff);
+    bool ok = query.exec();
+
+    int downsampled = 0;
+    if (ok) {
+        query.prepare(QString("DELETE FROM readings WHERE resolution = %1 AND timestamp < ?").arg(static_cast<int>(ReadingResolutionRaw)));
+        query.addBindValue(rawCutoff);
+        ok = query.exec();
+        downsampled = query.numRowsAffected();
+    }
+    if (ok) {
+        query.prepare("DELETE FROM readings WHERE timestamp < ?");
+        query.addBindValue(longTermCutoff);
+        ok = query.exec();
+    }
+    if (ok) {
+        query.prepare("DELETE FROM transitions WHERE timestamp < ?");
+        query.addBindValue(longTermCutoff);
+        ok = query.exec();
+    }
+
+    if (!ok) {
+        qCWarning(dcAirConditioning()) << "Unable to apply telemetry retention:" << query.lastError().text();
+        db.rollback();
+        return;
+    }
+    db.commit();
+    qCDebug(dcAirConditioning()) << "Folded" << downsampled << "raw zone readings into hourly averages";
+}
+
+ZoneTelemetry::ZoneTelemetry(const QString &path, QObject *parent):
+    QObject(parent),
+    m_fileName(path + "/airconditioning-telemetry.sqlite")
+{
+    qRegisterMetaType<ZoneHistoryEntries>();
+    qRegisterMetaType<QList<ZoneTransition>>();
+
+    m_flushTimer = new QTimer(this);
+    m_flushTimer->setSingleShot(true);
+    m_flushTimer->setInterval(flushInterval);
+    connect(m_flushTimer, &QTimer::timeout, this, &ZoneTelemetry::flush);
+
+    m_thread = new QThread(this);
+    m_writer = new ZoneTelemetryWriter(m_fileName);
+    m_writer->moveToThread(m_thread);
+    connect(m_writer, &ZoneTelemetryWriter::fetchFinished, this, &ZoneTelemetry::fetchFinished);
+    m_thread->start(QThread::LowPriority);
+
+    ZoneTelemetryWriter *writer = m_writer;
+    QMetaObject::invokeMethod(m_writer, [writer](){ writer->open(); }, Qt::QueuedConnection);
+}
+
+ZoneTelemetry::~ZoneTelemetry()
+{
+    flush();
+    ZoneTelemetryWriter *writer = m_writer;
+    // Queued calls are processed in order, so this returns once everything has been written
+    QMetaObject::invokeMethod(m_writer, [writer](){ writer->close(); }, Qt::BlockingQueuedConnection);
+    m_thread->quit();
+    m_thread->wait();
+    delete m_writer;
+}
+
+QString ZoneTelemetry::fileName() const
+{
+    return m_fileName;
+}
+
+void ZoneTelemetry::record(const QDateTime &timestamp, const ZoneInfo &zone)
+{
+    qint64 secs = timestamp.toSecsSinceEpoch();
+    int zoneStatus = static_cast<int>(zone.zoneStatus());
+
+    auto it = m_zoneStates.find(zone.id());
+    if (it == m_zoneStates.end()) {
+        // Unknown status on startup, anything that is set now is treated as starting now
+        it = m_zoneStates.insert(zone.id(), ZoneState());
+        it->lastReading = secs - readingInterval;
+    }
+
+    for (ZoneInfo::ZoneStatusFlag flag : transitionFlags) {
+        if ((zoneStatus ^ it->zoneStatus) & flag) {
+            ZoneTransition transition;
+            transition.zoneId = zone.id();
+            transition.timestamp = secs;
+            transition.flag = flag;
+            transition.active = zoneStatus & flag;
+            m_pendingTransitions.append(transition);
+        }
+    }
+
+    if (zoneStatus != it->zoneStatus || secs - it->lastReading >= readingInterval) {
+        ZoneReading reading;
+        reading.zoneId = zone.id();
+        reading.timestamp = secs;
+        reading.temperature = zone.temperature();
+        reading.humidity = zone.humidity();
+        reading.voc = zone.voc();
+        reading.pm25 = zone.pm25();
+        reading.currentSetpoint = zone.currentSetpoint();
+        reading.zoneStatus = zoneStatus;
+        m_pendingReadings.append(reading);
+        it->lastReading = secs;
+    }
+    it->zoneStatus = zoneStatus;
+    m_lastTimestamp = qMax(m_lastTimestamp, secs);
+
+    if (m_pendingReadings.count() + m_pendingTransitions.count() >= maxBatchSize) {
+        flush();
+    } else if (!m_flushTimer->isActive() && (!m_pendingReadings.isEmpty() || !m_pendingTransitions.isEmpty())) {
+        // Don't restart the timer, data must not be held back forever by subsequent readings
+        m_flushTimer->start();
+    }
+}
+
+void ZoneTelemetry::removeZone(const QUuid &zoneId)
+{
+    m_zoneStates.remove(zoneId);
+    flush();
+    ZoneTelemetryWriter *writer = m_writer;
+    QMetaObject::invokeMethod(m_writer, [writer, zoneId](){ writer->removeZone(zoneId); }, Qt::QueuedConnection);
+}
+
+int ZoneTelemetry::fetch(const QUuid &zoneId, const QDateTime &from, const QDateTime &to)
+{
+    int requestId = m_nextRequestId++;
+    qint64 fromSecs = from.toSecsSinceEpoch();
+    qint64 toSecs = to.toSecsSinceEpoch();
+    flush();
+    ZoneTelemetryWriter *writer = m_writer;
+    QMetaObject::invokeMethod(m_writer, [writer, requestId, zoneId, fromSecs, toSecs](){ writer->fetch(requestId, zoneId, fromSecs, toSecs); }, Qt::QueuedConnection);
+    return requestId;
+}
+
+void ZoneTelemetry::flush()
+{
+    m_flushTimer->stop();
+    if (m_pendingReadings.isEmpty() && m_pendingTransitions.isEmpty()) {
+        return;
+    }
+
+    ZoneTelemetryWriter *writer = m_writer;
+    QList<ZoneReading> readings = m_pendingReadings;
+    QList<ZoneTransition> transitions = m_pendingTransitions;
+    qint64 now = m_lastTimestamp;
+    QMetaObject::invokeMethod(m_writer, [writer, readings, transitions, now](){ writer->write(readings, transitions, now); }, Qt::QueuedConnection);
+    m_pendingReadings.clear();
+    m_pendingTransitions.clear();
+}
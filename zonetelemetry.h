@@ -0,0 +1,139 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-experience-plugin-airconditioning.
+*
+* nymea-experience-plugin-airconditioning is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-experience-plugin-airconditioning is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-experience-plugin-airconditioning. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef ZONETELEMETRY_H
+#define ZONETELEMETRY_H
+
+#include <QObject>
+#include <QDateTime>
+#include <QHash>
+#include <QUuid>
+
+#include "zoneinfo.h"
+#include "zonehistory.h"
+
+class QThread;
+class QTimer;
+
+struct ZoneReading {
+    QUuid zoneId;
+    qint64 timestamp = 0;
+    double temperature = 0;
+    double humidity = 0;
+    uint voc = 0;
+    double pm25 = 0;
+    double currentSetpoint = 0;
+    int zoneStatus = 0;
+};
+
+// A zone status flag being set (active) or cleared, e.g. a window being opened
+struct ZoneTransition {
+    QUuid zoneId;
+    qint64 timestamp = 0;
+    ZoneInfo::ZoneStatusFlag flag = ZoneInfo::ZoneStatusFlagNone;
+    bool active = false;
+};
+Q_DECLARE_METATYPE(ZoneTransition)
+Q_DECLARE_METATYPE(QList<ZoneTransition>)
+
+// Owns the telemetry database connection. Lives in the telemetry thread, so everything
+// in here may block.
+class ZoneTelemetryWriter : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ZoneTelemetryWriter(const QString &fileName);
+
+    void open();
+    void close();
+
+    // Inserts in a single transaction. now is used to apply the retention policy.
+    void write(const QList<ZoneReading> &readings, const QList<ZoneTransition> &transitions, qint64 now);
+    void removeZone(const QUuid &zoneId);
+    void fetch(int requestId, const QUuid &zoneId, qint64 from, qint64 to);
+
+signals:
+    void fetchFinished(int requestId, const ZoneHistoryEntries &readings, const QList<ZoneTransition> &transitions);
+
+private:
+    bool exec(const QString &statement);
+    // Folds raw readings older than the raw retention into hourly averages and drops
+    // whatever is older than the long term retention
+    void applyRetention(qint64 now);
+
+private:
+    QString m_fileName;
+    QString m_connectionName;
+    bool m_open = false;
+    qint64 m_lastRetention = 0;
+};
+
+// Persists zone readings and status transitions to a SQLite database. Readings are kept at
+// most once per minute and zone, unless the zone status changes. Everything is queued in
+// memory and written in one transaction every few minutes by a background thread, so the
+// main event loop never waits for the disk and flash storage sees few, large writes.
+// Raw readings are kept for 7 days and then averaged per hour. Hourly averages and
+// transitions are kept for 2 years.
+class ZoneTelemetry : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ZoneTelemetry(const QString &path, QObject *parent = nullptr);
+    // Writes pending data and waits for the database to be closed
+    ~ZoneTelemetry() override;
+
+    QString fileName() const;
+
+    void record(const QDateTime &timestamp, const ZoneInfo &zone);
+    void removeZone(const QUuid &zoneId);
+
+    // Fetches readings and transitions of a zone between from and to (inclusive) in the
+    // background, including pending ones. Returns the request id passed to fetchFinished().
+    int fetch(const QUuid &zoneId, const QDateTime &from, const QDateTime &to);
+
+public slots:
+    void flush();
+
+signals:
+    void fetchFinished(int requestId, const ZoneHistoryEntries &readings, const QList<ZoneTransition> &transitions);
+
+private:
+    struct ZoneState {
+        qint64 lastReading = 0;
+        int zoneStatus = 0;
+    };
+
+    QString m_fileName;
+    QThread *m_thread = nullptr;
+    ZoneTelemetryWriter *m_writer = nullptr;
+    QTimer *m_flushTimer = nullptr;
+
+    QHash<QUuid, ZoneState> m_zoneStates;
+    QList<ZoneReading> m_pendingReadings;
+    QList<ZoneTransition> m_pendingTransitions;
+    qint64 m_lastTimestamp = 0;
+    int m_nextRequestId = 1;
+};
+
+#endif // ZONETELEMETRY_H